@@ -0,0 +1,66 @@
+#ifndef BENCH_COMMON_H_DEFINED
+#define BENCH_COMMON_H_DEFINED
+
+#include "ndarray.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ax::bench {
+
+// Total sizes every benchmark runs at, from arrays that sit in the L1 cache
+// to arrays well past the last level.
+inline constexpr std::int64_t sizes[] = {1 << 10, 1 << 16, 1 << 22};
+
+// Shape of the given rank holding size elements, a power of two. The bits
+// are spread evenly with any left over going to the innermost axes.
+inline auto make_shape(std::size_t rank, std::size_t size) {
+    auto bits  = static_cast<std::size_t>(std::countr_zero(size));
+    auto shape = shape_type(rank);
+    for (std::size_t i = 0; i < rank; ++i)
+        shape[i] = std::size_t(1) << (bits / rank + (rank - i <= bits % rank));
+    return shape;
+}
+
+inline auto make_shape(const benchmark::State& state) {
+    return make_shape(static_cast<std::size_t>(state.range(0)),
+                      static_cast<std::size_t>(state.range(1)));
+}
+
+template<class Tp_ = double>
+inline auto make_array(const shape_type& shape) {
+    return random::randn<Tp_>(std::vector<std::size_t>(shape.begin(),
+                                                       shape.end()));
+}
+
+// Registers a benchmark for each rank from Min_ to 4 and each size. Time is
+// wall time since large arrays are split across threads.
+template<std::int64_t Min_>
+inline void ranks(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"rank", "size"})->UseRealTime();
+    for (auto rank = Min_; rank <= 4; ++rank)
+        for (auto size : sizes)
+            bench->Args({rank, size});
+}
+
+// Registers a benchmark for each size at rank one, for operations that see
+// the array as a flat buffer whatever its shape.
+inline void flat(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"rank", "size"})->UseRealTime();
+    for (auto size : sizes)
+        bench->Args({1, size});
+}
+
+// Reports throughput from the bytes one iteration reads and writes.
+inline void set_bytes(benchmark::State& state, std::size_t bytes) {
+    state.SetBytesProcessed(state.iterations()
+                            * static_cast<std::int64_t>(bytes));
+}
+
+} // namespace ax::bench
+
+#endif /* BENCH_COMMON_H_DEFINED */
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Flags benchmarks of axiom_bench that got slower than a stored baseline.
+
+Both files are the JSON output of Google Benchmark, written with
+
+    axiom_bench --benchmark_out=baseline.json --benchmark_out_format=json
+
+from a Release build on the same machine. Runs with repetitions are
+compared by the median of their repetitions. Exits with status 1 when any
+benchmark is slower than the baseline by more than the threshold, so that
+it can gate an upgrade.
+"""
+
+import argparse
+import json
+import statistics
+import sys
+
+UNITS = {"ns": 1e-9, "us": 1e-6, "ms": 1e-3, "s": 1.0}
+
+
+def load(path, metric):
+    """Seconds per iteration of each benchmark in a JSON file."""
+    with open(path) as f:
+        data = json.load(f)
+    times = {}
+    for bench in data["benchmarks"]:
+        if bench.get("run_type", "iteration") != "iteration":
+            continue
+        if "error_occurred" in bench:
+            continue
+        name = bench.get("run_name", bench["name"])
+        scale = UNITS[bench.get("time_unit", "ns")]
+        times.setdefault(name, []).append(bench[metric] * scale)
+    return {name: statistics.median(runs) for name, runs in times.items()}
+
+
+def format_time(seconds):
+    for unit in ("s", "ms", "us", "ns"):
+        if seconds >= UNITS[unit] or unit == "ns":
+            return f"{seconds / UNITS[unit]:.3g} {unit}"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline", help="JSON output of the baseline run")
+    parser.add_argument("current", help="JSON output of the run to check")
+    parser.add_argument("--threshold", type=float, default=0.05,
+                        help="relative slowdown that counts as a regression"
+                             " (default 0.05)")
+    parser.add_argument("--metric", choices=("real_time", "cpu_time"),
+                        default="real_time",
+                        help="time to compare (default real_time)")
+    parser.add_argument("--all", action="store_true",
+                        help="list every benchmark, not only the changes")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline, args.metric)
+    current = load(args.current, args.metric)
+    regressions = 0
+    rows = []
+    for name in sorted(baseline.keys() & current.keys()):
+        old, new = baseline[name], current[name]
+        change = new / old - 1
+        if change > args.threshold:
+            status = "REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            status = "faster"
+        elif args.all:
+            status = ""
+        else:
+            continue
+        rows.append((name, format_time(old), format_time(new),
+                     f"{change:+.1%}", status))
+
+    if rows:
+        width = max(len(row[0]) for row in rows)
+        for name, old, new, change, status in rows:
+            print(f"{name:<{width}}  {old:>10}  {new:>10}  {change:>8}  "
+                  f"{status}")
+    for name in sorted(baseline.keys() - current.keys()):
+        print(f"missing from current run: {name}")
+    for name in sorted(current.keys() - baseline.keys()):
+        print(f"not in baseline: {name}")
+
+    compared = len(baseline.keys() & current.keys())
+    print(f"{regressions} of {compared} benchmarks slower by more than "
+          f"{args.threshold:.0%}")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
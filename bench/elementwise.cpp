@@ -0,0 +1,225 @@
+#include "common.hpp"
+
+#include <functional>
+#include <utility>
+
+// Element-wise expressions over contiguous, strided and broadcast operands,
+// along with scalar operands and the math functions, and the broadcast()
+// kernels over the same.
+
+namespace ax::bench {
+
+template<class Tp_>
+static void add_contiguous(benchmark::State& state) {
+    auto shape  = make_shape(state);
+    auto a      = make_array<Tp_>(shape);
+    auto b      = make_array<Tp_>(shape);
+    auto result = ndarray<Tp_>(shape);
+    for (auto _ : state) {
+        result = a + b;
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 3 * a.size() * sizeof(Tp_));
+}
+
+// Every other element along the innermost axis.
+template<class Tp_>
+static void add_strided(benchmark::State& state) {
+    auto shape = make_shape(state);
+    auto wide  = shape;
+    wide.back() *= 2;
+    auto a      = make_array<Tp_>(shape);
+    auto b      = make_array<Tp_>(wide);
+    auto view   = b.slice(ellipsis, range(none, none, 2));
+    auto result = ndarray<Tp_>(shape);
+    for (auto _ : state) {
+        result = a + view;
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 3 * a.size() * sizeof(Tp_));
+}
+
+// An operand with its last two axes swapped, walked against its layout.
+template<class Tp_>
+static void add_transposed(benchmark::State& state) {
+    auto shape   = make_shape(state);
+    auto swapped = shape;
+    std::swap(swapped[shape.size() - 1], swapped[shape.size() - 2]);
+    auto a      = make_array<Tp_>(shape);
+    auto b      = make_array<Tp_>(swapped).transpose();
+    auto result = ndarray<Tp_>(shape);
+    for (auto _ : state) {
+        result = a + b;
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 3 * a.size() * sizeof(Tp_));
+}
+
+// A row broadcast down the outer axes.
+template<class Tp_>
+static void add_broadcast(benchmark::State& state) {
+    auto shape = make_shape(state);
+    auto row   = shape_type(shape.size(), 1);
+    row.back() = shape.back();
+    auto a      = make_array<Tp_>(shape);
+    auto b      = make_array<Tp_>(row);
+    auto result = ndarray<Tp_>(shape);
+    for (auto _ : state) {
+        result = a + b;
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 2 * a.size() * sizeof(Tp_));
+}
+
+template<class Tp_>
+static void scalar_ops(benchmark::State& state) {
+    auto shape  = make_shape(state);
+    auto a      = make_array<Tp_>(shape);
+    auto result = ndarray<Tp_>(shape);
+    for (auto _ : state) {
+        result = a * Tp_(2) + Tp_(1);
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 2 * a.size() * sizeof(Tp_));
+}
+
+template<class Tp_>
+static void add_inplace(benchmark::State& state) {
+    auto shape = make_shape(state);
+    auto a     = make_array<Tp_>(shape);
+    auto b     = make_array<Tp_>(shape);
+    for (auto _ : state) {
+        a += b;
+        benchmark::DoNotOptimize(a.data());
+    }
+    set_bytes(state, 3 * a.size() * sizeof(Tp_));
+}
+
+// The free broadcast() kernels, which the chunked arrays run on, as opposed
+// to the expressions above. Each allocates its result except for
+// broadcast_reused, whose expiring operand takes it.
+template<class Tp_>
+static void broadcast_contiguous(benchmark::State& state) {
+    auto shape = make_shape(state);
+    auto a     = make_array<Tp_>(shape);
+    auto b     = make_array<Tp_>(shape);
+    for (auto _ : state) {
+        auto result = broadcast(a, b, std::plus {});
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 3 * a.size() * sizeof(Tp_));
+}
+
+template<class Tp_>
+static void broadcast_strided(benchmark::State& state) {
+    auto shape = make_shape(state);
+    auto wide  = shape;
+    wide.back() *= 2;
+    auto a    = make_array<Tp_>(shape);
+    auto b    = make_array<Tp_>(wide);
+    auto view = b.slice(ellipsis, range(none, none, 2));
+    for (auto _ : state) {
+        auto result = broadcast(a, view, std::plus {});
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 3 * a.size() * sizeof(Tp_));
+}
+
+template<class Tp_>
+static void broadcast_transposed(benchmark::State& state) {
+    auto shape   = make_shape(state);
+    auto swapped = shape;
+    std::swap(swapped[shape.size() - 1], swapped[shape.size() - 2]);
+    auto a = make_array<Tp_>(shape);
+    auto b = make_array<Tp_>(swapped).transpose();
+    for (auto _ : state) {
+        auto result = broadcast(a, b, std::plus {});
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 3 * a.size() * sizeof(Tp_));
+}
+
+template<class Tp_>
+static void broadcast_rows(benchmark::State& state) {
+    auto shape = make_shape(state);
+    auto row   = shape_type(shape.size(), 1);
+    row.back() = shape.back();
+    auto a     = make_array<Tp_>(shape);
+    auto b     = make_array<Tp_>(row);
+    for (auto _ : state) {
+        auto result = broadcast(a, b, std::plus {});
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 2 * a.size() * sizeof(Tp_));
+}
+
+template<class Tp_>
+static void broadcast_scalar(benchmark::State& state) {
+    auto a = make_array<Tp_>(make_shape(state));
+    for (auto _ : state) {
+        auto result = broadcast(Tp_(2), a, std::multiplies {});
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 2 * a.size() * sizeof(Tp_));
+}
+
+template<class Tp_>
+static void broadcast_reused(benchmark::State& state) {
+    auto shape  = make_shape(state);
+    auto result = make_array<Tp_>(shape);
+    auto b      = make_array<Tp_>(shape);
+    for (auto _ : state) {
+        result = broadcast(std::move(result), b, std::plus {});
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 3 * b.size() * sizeof(Tp_));
+}
+
+// Allocates the result on every iteration, as apply() and the math
+// functions do.
+template<class Fn_>
+static void apply(benchmark::State& state, Fn_ func) {
+    auto a = make_array(make_shape(state));
+    for (auto _ : state) {
+        auto result = func(a);
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 2 * a.size() * sizeof(double));
+}
+
+BENCHMARK_TEMPLATE(add_contiguous, float)->Apply(ranks<1>);
+BENCHMARK_TEMPLATE(add_contiguous, double)->Apply(ranks<1>);
+BENCHMARK_TEMPLATE(add_strided, double)->Apply(ranks<1>);
+BENCHMARK_TEMPLATE(add_transposed, double)->Apply(ranks<2>);
+BENCHMARK_TEMPLATE(add_broadcast, double)->Apply(ranks<2>);
+BENCHMARK_TEMPLATE(scalar_ops, float)->Apply(ranks<1>);
+BENCHMARK_TEMPLATE(scalar_ops, double)->Apply(ranks<1>);
+BENCHMARK_TEMPLATE(add_inplace, double)->Apply(ranks<1>);
+
+BENCHMARK_TEMPLATE(broadcast_contiguous, double)->Apply(ranks<1>);
+BENCHMARK_TEMPLATE(broadcast_strided, double)->Apply(ranks<1>);
+BENCHMARK_TEMPLATE(broadcast_transposed, double)->Apply(ranks<2>);
+BENCHMARK_TEMPLATE(broadcast_rows, double)->Apply(ranks<2>);
+BENCHMARK_TEMPLATE(broadcast_scalar, double)->Apply(ranks<1>);
+BENCHMARK_TEMPLATE(broadcast_reused, double)->Apply(ranks<1>);
+
+BENCHMARK_CAPTURE(apply, lambda, [](const ndarray<double>& a) {
+    return a.apply([](const auto& x) { return x * x + x; });
+})->Apply(ranks<1>);
+BENCHMARK_CAPTURE(apply, exp, [](const ndarray<double>& a) {
+    return exp(a);
+})->Apply(ranks<1>);
+BENCHMARK_CAPTURE(apply, sin, [](const ndarray<double>& a) {
+    return sin(a);
+})->Apply(ranks<1>);
+BENCHMARK_CAPTURE(apply, tanh, [](const ndarray<double>& a) {
+    return tanh(a);
+})->Apply(ranks<1>);
+BENCHMARK_CAPTURE(apply, sqrt, [](const ndarray<double>& a) {
+    return sqrt(abs(a));
+})->Apply(ranks<1>);
+BENCHMARK_CAPTURE(apply, pow, [](const ndarray<double>& a) {
+    return pow(a, 3);
+})->Apply(ranks<1>);
+
+} // namespace ax::bench
@@ -0,0 +1,86 @@
+#include "common.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+// Copies that change the layout of an array: materialized transposes and
+// reshapes, in-place transposes and copies of slices.
+
+namespace ax::bench {
+
+// Reverses the axes and lays the result out row-major.
+template<class Tp_>
+static void transpose_copy(benchmark::State& state) {
+    auto a    = make_array<Tp_>(make_shape(state));
+    auto axes = std::vector<std::size_t>(a.rank());
+    std::iota(axes.rbegin(), axes.rend(), 0);
+    for (auto _ : state) {
+        auto result = a.transpose(axes).as_layout(stride_type::row_major);
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 2 * a.size() * sizeof(Tp_));
+}
+
+// Swaps the last two axes, which reshape() has to materialize.
+template<class Tp_>
+static void reshape_transposed(benchmark::State& state) {
+    auto a = make_array<Tp_>(make_shape(state));
+    for (auto _ : state) {
+        auto result = a.transpose().reshape({a.size()});
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 2 * a.size() * sizeof(Tp_));
+}
+
+template<class Tp_>
+static void column_major(benchmark::State& state) {
+    auto a = make_array<Tp_>(make_shape(state));
+    for (auto _ : state) {
+        auto result = a.as_layout(stride_type::column_major);
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 2 * a.size() * sizeof(Tp_));
+}
+
+// The last two axes are made square, keeping about the same size.
+template<class Tp_>
+static void transpose_inplace(benchmark::State& state) {
+    auto shape = make_shape(state);
+    auto rank  = shape.size();
+    auto bits  = std::countr_zero(shape[rank - 1] * shape[rank - 2]);
+    shape[rank - 1] = shape[rank - 2] = std::size_t(1) << bits / 2;
+    auto a = make_array<Tp_>(shape);
+    for (auto _ : state) {
+        ax::transpose_inplace(a);
+        benchmark::DoNotOptimize(a.data());
+    }
+    set_bytes(state, 2 * a.size() * sizeof(Tp_));
+}
+
+// Every other element along the outermost and innermost axes, copied out
+// of the view.
+template<class Tp_>
+static void slice_copy(benchmark::State& state) {
+    auto shape = make_shape(state);
+    shape.front() *= 2;
+    shape.back() *= 2;
+    auto a    = make_array<Tp_>(shape);
+    auto view = a.slice(range(none, none, 2), ellipsis, range(none, none, 2));
+    for (auto _ : state) {
+        auto result = view.as_layout(stride_type::row_major);
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 2 * view.size() * sizeof(Tp_));
+}
+
+BENCHMARK_TEMPLATE(transpose_copy, float)->Apply(ranks<2>);
+BENCHMARK_TEMPLATE(transpose_copy, double)->Apply(ranks<2>);
+BENCHMARK_TEMPLATE(reshape_transposed, double)->Apply(ranks<2>);
+BENCHMARK_TEMPLATE(column_major, double)->Apply(ranks<2>);
+BENCHMARK_TEMPLATE(transpose_inplace, float)->Apply(ranks<2>);
+BENCHMARK_TEMPLATE(transpose_inplace, double)->Apply(ranks<2>);
+BENCHMARK_TEMPLATE(slice_copy, double)->Apply(ranks<2>);
+
+} // namespace ax::bench
@@ -0,0 +1,38 @@
+#include "common.hpp"
+
+#include <cstdint>
+#include <format>
+#include <sstream>
+
+// Formatting arrays as text, at sizes someone would print.
+
+namespace ax::bench {
+
+static void print_sizes(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"rank", "size"});
+    for (std::int64_t rank = 1; rank <= 4; ++rank)
+        for (std::int64_t size : {1 << 6, 1 << 10, 1 << 14})
+            bench->Args({rank, size});
+}
+
+static void print_stream(benchmark::State& state) {
+    auto a = make_array(make_shape(state));
+    for (auto _ : state) {
+        auto os = std::ostringstream();
+        os << a;
+        benchmark::DoNotOptimize(os.str().size());
+    }
+    set_bytes(state, a.size() * sizeof(double));
+}
+
+static void print_format(benchmark::State& state) {
+    auto a = make_array(make_shape(state));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(std::format("{}", a).size());
+    set_bytes(state, a.size() * sizeof(double));
+}
+
+BENCHMARK(print_stream)->Apply(print_sizes);
+BENCHMARK(print_format)->Apply(print_sizes);
+
+} // namespace ax::bench
@@ -0,0 +1,31 @@
+#include "common.hpp"
+
+#include <cstddef>
+
+// Filling arrays from the samplers of ax::random.
+
+namespace ax::bench {
+
+template<class Sm_>
+static void sample(benchmark::State& state, Sm_ sampler) {
+    using Tp_  = typename Sm_::value_type;
+    auto gen   = random::generator(42);
+    auto array = ndarray<Tp_>(make_shape(state));
+    for (auto _ : state) {
+        random::fill(gen, array, sampler);
+        benchmark::DoNotOptimize(array.data());
+    }
+    set_bytes(state, array.size() * sizeof(Tp_));
+}
+
+BENCHMARK_CAPTURE(sample, uniform_float, random::uniform<float>())->Apply(flat);
+BENCHMARK_CAPTURE(sample, uniform, random::uniform<double>())->Apply(flat);
+BENCHMARK_CAPTURE(sample, normal_float, random::normal<float>())->Apply(flat);
+BENCHMARK_CAPTURE(sample, normal, random::normal<double>())->Apply(flat);
+BENCHMARK_CAPTURE(sample, exponential, random::exponential<double>())
+    ->Apply(flat);
+BENCHMARK_CAPTURE(sample, uniform_int, random::uniform_int<int>(0, 100))
+    ->Apply(flat);
+BENCHMARK_CAPTURE(sample, bernoulli, random::bernoulli(0.3))->Apply(flat);
+
+} // namespace ax::bench
@@ -0,0 +1,49 @@
+#include "common.hpp"
+
+#include <cstddef>
+
+// Reductions over the whole array and along its innermost and outermost
+// axes.
+
+namespace ax::bench {
+
+template<class Fn_>
+static void reduce(benchmark::State& state, Fn_ func) {
+    auto a = make_array(make_shape(state));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(func(a));
+    set_bytes(state, a.size() * sizeof(double));
+}
+
+BENCHMARK_CAPTURE(reduce, sum, [](const ndarray<double>& a) {
+    return sum(a);
+})->Apply(ranks<1>);
+BENCHMARK_CAPTURE(reduce, sum_kahan, [](const ndarray<double>& a) {
+    return sum(a, summation::kahan);
+})->Apply(ranks<1>);
+BENCHMARK_CAPTURE(reduce, max, [](const ndarray<double>& a) {
+    return max(a);
+})->Apply(ranks<1>);
+BENCHMARK_CAPTURE(reduce, argmax, [](const ndarray<double>& a) {
+    return argmax(a);
+})->Apply(ranks<1>);
+BENCHMARK_CAPTURE(reduce, var, [](const ndarray<double>& a) {
+    return var(a);
+})->Apply(ranks<1>);
+BENCHMARK_CAPTURE(reduce, sum_inner, [](const ndarray<double>& a) {
+    return sum(a, a.rank() - 1).data();
+})->Apply(ranks<2>);
+BENCHMARK_CAPTURE(reduce, sum_outer, [](const ndarray<double>& a) {
+    return sum(a, 0).data();
+})->Apply(ranks<2>);
+BENCHMARK_CAPTURE(reduce, max_inner, [](const ndarray<double>& a) {
+    return max(a, a.rank() - 1).data();
+})->Apply(ranks<2>);
+BENCHMARK_CAPTURE(reduce, var_outer, [](const ndarray<double>& a) {
+    return var(a, 0).data();
+})->Apply(ranks<2>);
+BENCHMARK_CAPTURE(reduce, sum_transposed, [](const ndarray<double>& a) {
+    return sum(a.transpose(), a.rank() - 1).data();
+})->Apply(ranks<2>);
+
+} // namespace ax::bench
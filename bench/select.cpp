@@ -0,0 +1,93 @@
+#include "common.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// Fancy indexing: gathers at random positions and selections by a mask of
+// random bits.
+
+namespace ax::bench {
+
+static auto random_positions(std::size_t count, std::size_t size) {
+    auto gen     = random::generator(7);
+    auto indices = ndarray<std::int64_t>(shape_type {count});
+    random::fill(gen, indices,
+                 random::uniform_int<std::int64_t>(
+                     0, static_cast<std::int64_t>(size) - 1));
+    return indices;
+}
+
+static auto random_mask(const shape_type& shape) {
+    auto gen  = random::generator(7);
+    auto mask = ndarray<bool>(shape);
+    random::fill(gen, mask, random::bernoulli(0.5));
+    return mask;
+}
+
+template<class Tp_>
+static void take(benchmark::State& state) {
+    auto a       = make_array<Tp_>(make_shape(state));
+    auto indices = random_positions(a.size(), a.size());
+    for (auto _ : state) {
+        auto result = ax::take(a, indices);
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, a.size() * (2 * sizeof(Tp_) + sizeof(std::int64_t)));
+}
+
+// Rows picked along the outermost axis.
+template<class Tp_>
+static void take_rows(benchmark::State& state) {
+    auto a       = make_array<Tp_>(make_shape(state));
+    auto indices = random_positions(a.extent(0), a.extent(0));
+    for (auto _ : state) {
+        auto result = ax::take(a, indices, 0);
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, 2 * a.size() * sizeof(Tp_));
+}
+
+template<class Tp_>
+static void compress(benchmark::State& state) {
+    auto a    = make_array<Tp_>(make_shape(state));
+    auto mask = random_mask(a.shape());
+    for (auto _ : state) {
+        auto result = ax::compress(mask, a);
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, a.size() * (sizeof(Tp_) + sizeof(bool)));
+}
+
+template<class Tp_>
+static void place(benchmark::State& state) {
+    auto a      = make_array<Tp_>(make_shape(state));
+    auto mask   = random_mask(a.shape());
+    auto values = ax::compress(mask, a);
+    for (auto _ : state) {
+        ax::place(a, mask, values);
+        benchmark::DoNotOptimize(a.data());
+    }
+    set_bytes(state, a.size() * (2 * sizeof(Tp_) + sizeof(bool)));
+}
+
+template<class Tp_>
+static void where(benchmark::State& state) {
+    auto a    = make_array<Tp_>(make_shape(state));
+    auto b    = make_array<Tp_>(a.shape());
+    auto mask = random_mask(a.shape());
+    for (auto _ : state) {
+        auto result = ax::where(mask, a, b);
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_bytes(state, a.size() * (3 * sizeof(Tp_) + sizeof(bool)));
+}
+
+BENCHMARK_TEMPLATE(take, float)->Apply(flat);
+BENCHMARK_TEMPLATE(take, double)->Apply(flat);
+BENCHMARK_TEMPLATE(take_rows, double)->Apply(ranks<2>);
+BENCHMARK_TEMPLATE(compress, float)->Apply(flat);
+BENCHMARK_TEMPLATE(compress, double)->Apply(flat);
+BENCHMARK_TEMPLATE(place, double)->Apply(flat);
+BENCHMARK_TEMPLATE(where, double)->Apply(ranks<1>);
+
+} // namespace ax::bench
@@ -0,0 +1,173 @@
+#ifndef STATIC_VECTOR_H_DEFINED
+#define STATIC_VECTOR_H_DEFINED
+
+#include "../core.hpp"
+
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+
+namespace ax {
+
+// A vector with a fixed capacity stored inline. Used for shape and stride
+// metadata so that creating arrays and views never touches the heap.
+template<class Tp_, std::size_t N_>
+    requires(std::is_trivially_copyable_v<Tp_>)
+class static_vector {
+ public:
+    using value_type             = Tp_;
+    using size_type              = std::size_t;
+    using difference_type        = std::ptrdiff_t;
+    using reference              = Tp_&;
+    using const_reference        = const Tp_&;
+    using pointer                = Tp_*;
+    using const_pointer          = const Tp_*;
+    using iterator               = Tp_*;
+    using const_iterator         = const Tp_*;
+    using reverse_iterator       = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    static constexpr auto capacity() noexcept {
+        return N_;
+    }
+
+    constexpr auto size() const noexcept {
+        return size_;
+    }
+
+    constexpr auto empty() const noexcept {
+        return size_ == 0;
+    }
+
+    constexpr auto data() noexcept {
+        return data_;
+    }
+
+    constexpr auto data() const noexcept {
+        return static_cast<const Tp_*>(data_);
+    }
+
+    constexpr auto begin() noexcept {
+        return data();
+    }
+
+    constexpr auto begin() const noexcept {
+        return data();
+    }
+
+    constexpr auto end() noexcept {
+        return data() + size_;
+    }
+
+    constexpr auto end() const noexcept {
+        return data() + size_;
+    }
+
+    constexpr auto rbegin() noexcept {
+        return reverse_iterator(end());
+    }
+
+    constexpr auto rbegin() const noexcept {
+        return const_reverse_iterator(end());
+    }
+
+    constexpr auto rend() noexcept {
+        return reverse_iterator(begin());
+    }
+
+    constexpr auto rend() const noexcept {
+        return const_reverse_iterator(begin());
+    }
+
+    constexpr auto& front() const noexcept {
+        return data_[0];
+    }
+
+    constexpr auto& front() noexcept {
+        return data_[0];
+    }
+
+    constexpr auto& back() const noexcept {
+        return data_[size_ - 1];
+    }
+
+    constexpr auto& back() noexcept {
+        return data_[size_ - 1];
+    }
+
+    constexpr auto& at(size_type pos) const {
+        ax_assert(pos < size_, "Index out of bounds!");
+        return data_[pos];
+    }
+
+    constexpr auto& at(size_type pos) {
+        ax_assert(pos < size_, "Index out of bounds!");
+        return data_[pos];
+    }
+
+    constexpr auto& operator[](size_type pos) const noexcept {
+        return data_[pos];
+    }
+
+    constexpr auto& operator[](size_type pos) noexcept {
+        return data_[pos];
+    }
+
+    constexpr void push_back(const Tp_& value) {
+        ax_assert(size_ < N_, "Exceeded capacity of static vector!");
+        data_[size_++] = value;
+    }
+
+    constexpr void pop_back() noexcept {
+        --size_;
+    }
+
+    constexpr void resize(size_type count, const Tp_& value = Tp_ {}) {
+        ax_assert(count <= N_, "Exceeded capacity of static vector!");
+        if (count > size_)
+            std::fill(data_ + size_, data_ + count, value);
+        size_ = count;
+    }
+
+    constexpr void clear() noexcept {
+        size_ = 0;
+    }
+
+    constexpr static_vector() = default;
+
+    constexpr explicit static_vector(size_type  count,
+                                     const Tp_& value = Tp_ {}) {
+        resize(count, value);
+    }
+
+    template<std::input_iterator It_>
+    constexpr static_vector(It_ first, It_ last) {
+        for (; first != last; ++first)
+            push_back(*first);
+    }
+
+    template<std::ranges::input_range Rn_>
+        requires(!std::is_same_v<std::remove_cvref_t<Rn_>, static_vector>)
+    constexpr static_vector(const Rn_& range)
+        : static_vector(std::ranges::begin(range), std::ranges::end(range)) {
+    }
+
+    constexpr static_vector(std::initializer_list<Tp_> list)
+        : static_vector(list.begin(), list.end()) {
+    }
+
+    friend constexpr auto operator==(const static_vector& lhs,
+                                     const static_vector& rhs) {
+        return std::ranges::equal(lhs, rhs);
+    }
+
+ private:
+    Tp_       data_[N_] = {};
+    size_type size_     = 0;
+};
+
+} // namespace ax
+
+#endif /* STATIC_VECTOR_H_DEFINED */
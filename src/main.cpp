@@ -1,17 +1,4 @@
 #include "ndarray.hpp"
 
-#include <benchmark/benchmark.h>
-
-// static void broadcast_test(benchmark::State& state) {
-//     static auto a = ax::random::randn({100, 100});
-//     static auto b = ax::random::randn({100, 100}).transpose();
-//     for (auto _ : state) {
-//         a += 1;
-//     }
-// }
-// BENCHMARK(broadcast_test);
-
-// BENCHMARK_MAIN();
-
 int main() {
-}
\ No newline at end of file
+}
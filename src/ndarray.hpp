@@ -1,10 +1,14 @@
 #ifndef NDARRAY_H_DEFINED
 #define NDARRAY_H_DEFINED
 
+#include "ndarray/chunked.hpp"
 #include "ndarray/core.hpp"
+#include "ndarray/linalg.hpp"
 #include "ndarray/math.hpp"
+#include "ndarray/npy.hpp"
 #include "ndarray/print.hpp"
 #include "ndarray/random.hpp"
+#include "ndarray/select.hpp"
 #include "ndarray/utils.hpp"
 
 #endif /* NDARRAY_H_DEFINED */
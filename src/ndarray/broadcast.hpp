@@ -4,10 +4,17 @@
 #include "../core.hpp"
 #include "concepts.hpp"
 #include "extents.hpp"
+#include "kernels.hpp"
+#include "layout.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
 
 #include <algorithm>
+#include <array>
 #include <functional>
+#include <span>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace ax {
@@ -19,9 +26,13 @@ inline void linear_walk(Tp1_* const       data1,
                         const Tp2_* const data2,
                         Fn_&&             func,
                         std::size_t       size) {
+    if constexpr (simd_kernel<std::remove_cvref_t<Fn_>, Tp1_, Tp2_>) {
+        simd_linear_kernel(data1, data2, func, size);
+    } else {
 #pragma omp simd
-    for (std::size_t i = 0; i < size; ++i)
-        data1[i] = func(data2[i]);
+        for (std::size_t i = 0; i < size; ++i)
+            data1[i] = func(data2[i]);
+    }
 }
 
 template<class Tp2_,
@@ -33,113 +44,161 @@ inline void linear_walk(Tp1_* const       data1,
                         const Tp3_* const data3,
                         Fn_&&             func,
                         std::size_t       size) {
+    if constexpr (simd_kernel<std::remove_cvref_t<Fn_>, Tp1_, Tp2_, Tp3_>) {
+        simd_linear_kernel(data1, data2, data3, func, size);
+    } else {
 #pragma omp simd
-    for (std::size_t i = 0; i < size; ++i)
-        data1[i] = func(data2[i], data3[i]);
+        for (std::size_t i = 0; i < size; ++i)
+            data1[i] = func(data2[i], data3[i]);
+    }
 }
 
-template<class Tp2_, class Fn_, class Tp1_ = std::invoke_result_t<Fn_, Tp2_>>
-inline void strided_walk(Tp1_* const        data1,
-                         const Tp2_* const  data2,
-                         Fn_&&              func,
-                         const std::size_t* shape,
-                         const std::size_t* strides,
-                         std::size_t        rank,
-                         std::size_t&       idx1,
-                         std::size_t        idx2 = 0) {
-    auto stride = *strides;
-    auto dim    = *shape;
-    if (rank == 1) {
-#pragma omp simd
-        for (std::size_t i = 0; i < dim; ++i) {
-            data1[idx1++] = func(data2[idx2]);
-            idx2 += stride;
-        }
-    } else {
-        shape++;
-        strides++;
-        rank--;
-        for (std::size_t i = 0; i < dim; ++i) {
-            strided_walk(data1, data2, func, shape, strides, rank, idx1, idx2);
-            idx2 += stride;
-        }
+// Runs one row of a loop nest, through the linear kernels when every
+// operand is contiguous along it and through the strided ones when the
+// output is.
+template<class Tp1_, class Tp2_, class Fn_>
+inline void row_walk(Tp1_* const       data1,
+                     const Tp2_* const data2,
+                     const Fn_&        func,
+                     std::size_t       size,
+                     std::ptrdiff_t    stride1,
+                     std::ptrdiff_t    stride2) {
+    if (stride1 == 1 && stride2 == 1)
+        return linear_walk(data1, data2, func, size);
+    if constexpr (simd_kernel<Fn_, Tp1_, Tp2_>) {
+        if (stride1 == 1)
+            return simd_strided_kernel(data1, data2, func, size, stride2);
     }
+#pragma omp simd
+    for (std::ptrdiff_t i = 0; i < static_cast<std::ptrdiff_t>(size); ++i)
+        data1[i * stride1] = func(data2[i * stride2]);
 }
 
-template<class Tp2_,
-         class Tp3_,
-         class Fn_,
-         class Tp1_ = std::invoke_result_t<Fn_, Tp2_, Tp3_>>
-inline void strided_walk(Tp1_* const        data1,
-                         const Tp2_* const  data2,
-                         const Tp3_* const  data3,
-                         Fn_&&              func,
-                         const std::size_t* shape,
-                         const std::size_t* strides,
-                         std::size_t        rank,
-                         std::size_t&       idx12,
-                         std::size_t        idx3 = 0) {
-    auto stride = *strides;
-    auto dim    = *shape;
-    if (rank == 1) {
+template<class Tp1_, class Tp2_, class Tp3_, class Fn_>
+inline void row_walk(Tp1_* const       data1,
+                     const Tp2_* const data2,
+                     const Tp3_* const data3,
+                     const Fn_&        func,
+                     std::size_t       size,
+                     std::ptrdiff_t    stride1,
+                     std::ptrdiff_t    stride2,
+                     std::ptrdiff_t    stride3) {
+    if (stride1 == 1 && stride2 == 1 && stride3 == 1)
+        return linear_walk(data1, data2, data3, func, size);
+    if constexpr (simd_kernel<Fn_, Tp1_, Tp2_, Tp3_>) {
+        if (stride1 == 1)
+            return simd_strided_kernel(data1, data2, data3, func, size,
+                                       stride2, stride3);
+    }
 #pragma omp simd
-        for (std::size_t i = 0; i < dim; ++i) {
-            data1[idx12] = func(data2[idx12], data3[idx3]);
-            idx3 += stride;
-            idx12++;
-        }
-    } else {
-        shape++;
-        strides++;
-        rank--;
-        for (std::size_t i = 0; i < dim; ++i) {
-            strided_walk(data1, data2, func, shape, strides, rank, idx12, idx3);
-            idx3 += stride;
-        }
+    for (std::ptrdiff_t i = 0; i < static_cast<std::ptrdiff_t>(size); ++i)
+        data1[i * stride1] = func(data2[i * stride2], data3[i * stride3]);
+}
+
+// Walks an element-wise operation over the loop nest of the output and its
+// operands, the output coming first so it is written in memory order. The
+// rows are split across threads, or the row itself when the nest has
+// merged into a single one. Returns whether it has.
+template<class Tp1_, class Tp2_, class Fn_>
+inline bool nest_walk(Tp1_* const       data1,
+                      const Tp2_* const data2,
+                      const Fn_&        func,
+                      const shape_type& shape,
+                      const shape_type& strides1,
+                      const shape_type& strides2) {
+    auto nest    = loop_nest(shape, std::array {strides1, strides2});
+    auto strides = std::array {nest.strides(strides1), nest.strides(strides2)};
+    auto inner   = nest.inner();
+    auto s1      = static_cast<std::ptrdiff_t>(strides[0].back());
+    auto s2      = static_cast<std::ptrdiff_t>(strides[1].back());
+    if (nest.rank() == 1) {
+        parallel_for(
+            inner, 1,
+            [&](std::size_t first, std::size_t last) {
+                auto i = static_cast<std::ptrdiff_t>(first);
+                row_walk(data1 + i * s1, data2 + i * s2, func, last - first,
+                         s1, s2);
+            },
+            line_grain<Tp1_>);
+        return true;
     }
+    parallel_for(nest.rows(), inner, [&](std::size_t first, std::size_t last) {
+        walk_rows(nest.shape(), strides, first, last,
+                  [&](const auto&, const auto& offsets) {
+                      row_walk(data1 + offsets[0], data2 + offsets[1], func,
+                               inner, s1, s2);
+                  });
+    });
+    return false;
 }
 
-template<class Tp2_,
-         class Tp3_,
-         class Fn_,
-         class Tp1_ = std::invoke_result_t<Fn_, Tp2_, Tp3_>>
-inline void strided_walk(Tp1_* const        data1,
-                         const Tp2_* const  data2,
-                         const Tp3_* const  data3,
-                         Fn_&&              func,
-                         const std::size_t* shape,
-                         const std::size_t* strides2,
-                         const std::size_t* strides3,
-                         std::size_t        rank,
-                         std::size_t&       idx1,
-                         std::size_t        idx2 = 0,
-                         std::size_t        idx3 = 0) {
-    auto stride2 = *strides2;
-    auto stride3 = *strides3;
-    auto dim     = *shape;
-    if (rank == 1) {
-#pragma omp simd
-        for (std::size_t i = 0; i < dim; ++i) {
-            data1[idx1++] = func(data2[idx2], data3[idx3]);
-            idx2 += stride2;
-            idx3 += stride3;
-        }
-    } else {
-        shape++;
-        strides2++;
-        strides3++;
-        rank--;
-        for (std::size_t i = 0; i < dim; ++i) {
-            strided_walk(data1, data2, data3, func, shape, strides2, strides3,
-                         rank, idx1, idx2, idx3);
-            idx2 += stride2;
-            idx3 += stride3;
-        }
+template<class Tp1_, class Tp2_, class Tp3_, class Fn_>
+inline bool nest_walk(Tp1_* const       data1,
+                      const Tp2_* const data2,
+                      const Tp3_* const data3,
+                      const Fn_&        func,
+                      const shape_type& shape,
+                      const shape_type& strides1,
+                      const shape_type& strides2,
+                      const shape_type& strides3) {
+    auto nest    = loop_nest(shape, std::array {strides1, strides2, strides3});
+    auto strides = std::array {nest.strides(strides1), nest.strides(strides2),
+                               nest.strides(strides3)};
+    auto inner   = nest.inner();
+    auto s1      = static_cast<std::ptrdiff_t>(strides[0].back());
+    auto s2      = static_cast<std::ptrdiff_t>(strides[1].back());
+    auto s3      = static_cast<std::ptrdiff_t>(strides[2].back());
+    if (nest.rank() == 1) {
+        parallel_for(
+            inner, 1,
+            [&](std::size_t first, std::size_t last) {
+                auto i = static_cast<std::ptrdiff_t>(first);
+                row_walk(data1 + i * s1, data2 + i * s2, data3 + i * s3, func,
+                         last - first, s1, s2, s3);
+            },
+            line_grain<Tp1_>);
+        return true;
     }
+    parallel_for(nest.rows(), inner, [&](std::size_t first, std::size_t last) {
+        walk_rows(nest.shape(), strides, first, last,
+                  [&](const auto&, const auto& offsets) {
+                      row_walk(data1 + offsets[0], data2 + offsets[1],
+                               data3 + offsets[2], func, inner, s1, s2, s3);
+                  });
+    });
+    return false;
+}
+
+template<class Tp1_, class Tp2_, class Fn_>
+inline void parallel_linear_walk(Tp1_* const       data1,
+                                 const Tp2_* const data2,
+                                 const Fn_&        func,
+                                 std::size_t       size) {
+    parallel_for(
+        size, 1,
+        [&](std::size_t first, std::size_t last) {
+            linear_walk(data1 + first, data2 + first, func, last - first);
+        },
+        line_grain<Tp1_>);
+}
+
+template<class Tp1_, class Tp2_, class Tp3_, class Fn_>
+inline void parallel_linear_walk(Tp1_* const       data1,
+                                 const Tp2_* const data2,
+                                 const Tp3_* const data3,
+                                 const Fn_&        func,
+                                 std::size_t       size) {
+    parallel_for(
+        size, 1,
+        [&](std::size_t first, std::size_t last) {
+            linear_walk(data1 + first, data2 + first, data3 + first, func,
+                        last - first);
+        },
+        line_grain<Tp1_>);
 }
 
-constexpr void is_broadcastable(const std::vector<std::size_t>& shape1,
-                                const std::vector<std::size_t>& shape2) {
+constexpr void is_broadcastable(std::span<const std::size_t> shape1,
+                                std::span<const std::size_t> shape2) {
     auto rank1 = shape1.size();
     auto rank2 = shape2.size();
     auto rmin  = std::min(rank1, rank2);
@@ -152,114 +211,77 @@ constexpr void is_broadcastable(const std::vector<std::size_t>& shape1,
     }
 }
 
-constexpr auto is_broadcastable_and_return_shape(
-    const std::vector<std::size_t>& shape1,
-    const std::vector<std::size_t>& shape2) {
+constexpr auto
+is_broadcastable_and_return_shape(std::span<const std::size_t> shape1,
+                                  std::span<const std::size_t> shape2) {
     auto rank1        = shape1.size();
     auto rank2        = shape2.size();
     auto [rmin, rmax] = std::minmax(rank1, rank2);
-    auto shape3       = std::vector<std::size_t>(rmax);
+    auto shape3       = shape_type(rmax);
 
     auto& ishape = rank1 > rank2 ? shape1 : shape2;
     for (std::size_t i = 0; i < rmax - rmin; ++i)
         shape3[i] = ishape[i];
 
-    auto ptr = &shape3.back();
     for (std::size_t i = 0; i < rmin; ++i) {
         auto x1 = shape1[rank1 - i - 1];
         auto x2 = shape2[rank2 - i - 1];
         ax_assert(x1 == x2 || x1 == 1 || x2 == 1,
                   "Cannot broadcast arrays of incompatible shape!");
-        *(ptr--) = std::max(x1, x2);
+        shape3[rmax - i - 1] = std::max(x1, x2);
     }
 
     return shape3;
 }
 
-constexpr auto make_new_shape_strides(
-    const std::vector<std::size_t>& shape1,
-    const std::vector<std::size_t>& shape2,
-    const std::vector<std::size_t>& strides1,
-    const std::vector<std::size_t>& strides2) {
-    auto size1  = shape1.size();
-    auto size2  = shape2.size();
-    auto result = std::vector<std::size_t>(2 * size1 + 2 * size2);
-
-    std::size_t rank1 = 0;
-    std::size_t rank2 = 0;
-    std::size_t idx   = 0;
-    for (auto&& [dim, stride] : std::views::zip(shape1, strides1)) {
-        if (dim == 1)
-            continue;
-        result[idx]         = dim;
-        result[idx + size1] = stride;
-        rank1++;
-        idx++;
-    }
-    idx = 2 * size1;
-    for (auto&& [dim, stride] : std::views::zip(shape2, strides2)) {
-        if (dim == 1)
-            continue;
-        result[idx]         = dim;
-        result[idx + size2] = stride;
-        rank2++;
-        idx++;
-    }
-    return std::make_tuple(result, rank1, rank2);
+// Strides of an array aligned against the trailing axes of a shape it is
+// broadcast to, zero along the axes it is broadcast over.
+constexpr auto broadcast_strides(const shape_type& shape,
+                                 const shape_type& strides,
+                                 const shape_type& oshape) {
+    auto result = shape_type(oshape.size(), 0);
+    auto rdiff  = oshape.size() - shape.size();
+    for (std::size_t i = 0; i < shape.size(); ++i)
+        if (shape[i] != 1)
+            result[i + rdiff] = strides[i];
+    return result;
 }
 
-template<class Tp1_, class Tp2_, class Tp3_, class Fn_>
-constexpr void broadcast_helper(Tp1_* const        data1,
-                                const Tp2_* const  data2,
-                                const Tp3_* const  data3,
-                                Fn_&&              func,
-                                const std::size_t* shape2,
-                                const std::size_t* shape3,
-                                const std::size_t* strides2,
-                                const std::size_t* strides3,
-                                std::size_t        rank2,
-                                std::size_t        rank3,
-                                std::size_t        size2,
-                                std::size_t        size3) {
-    auto [rmin, rmax] = std::minmax(rank2, rank3);
-    auto rdiff        = rmax - rmin;
-
-    auto is_strided_same
-        = detail::is_strided_same(strides2, strides3, rank2, rank3);
-    auto is_same_size = size2 == size3;
-
-    if (is_strided_same && is_same_size) {
-        detail::linear_walk(data1, data2, data3, func, size2);
-    } else if (is_same_size) {
-        std::size_t idx = 0;
-        detail::strided_walk(data1, data2, data3, func, shape2, strides2,
-                             strides3, rank2, idx);
-    } else if (is_strided_same) {
-        auto [stride, n, tsize, idata, bdata]
-            = rank2 > rank3
-                ? std::make_tuple(strides2[rdiff - 1], size2 / size3, size3,
-                                  data2, data3)
-                : std::make_tuple(strides3[rdiff - 1], size3 / size2, size2,
-                                  data3, data2);
-        std::size_t idx = 0;
-        for (std::size_t i = 0; i < n * stride; i += stride) {
-            detail::linear_walk(&data1[tsize], idata + i, bdata, func, tsize);
-            idx += tsize;
-        }
-    } else {
-        auto [stride, n, tsize, idata, bdata, istrides, bstrides, bshape, brank]
-            = rank2 > rank3
-                ? std::make_tuple(strides2[rdiff - 1], size2 / size3, size3,
-                                  data2, data3, strides2 + rdiff, strides3,
-                                  shape3, rank3)
-                : std::make_tuple(strides3[rdiff - 1], size3 / size2, size2,
-                                  data3, data2, strides3 + rdiff, strides2,
-                                  shape2, rank2);
-        std::size_t idx = 0;
-        for (std::size_t i = 0; i < n * stride; i += stride)
-            detail::strided_walk(data1, idata + i, bdata, func, bshape,
-                                 istrides, bstrides, brank, idx);
-    }
+// Operands of an element-wise operation vote for the layout of its result,
+// one bit per layout. Only operands of the output shape vote, for their
+// layout unless they are contiguous in both. The result is column-major
+// when some operand votes for it and none for row-major.
+constexpr auto layout_vote(stride_type layout) noexcept {
+    return layout == stride_type::row_major ? 1u : 2u;
+}
+
+template<class Ar_>
+constexpr auto layout_votes(const Ar_& array, const shape_type& shape) {
+    if (array.shape() != shape)
+        return 0u;
+    auto row = array.is_contiguous(stride_type::row_major);
+    auto col = array.is_contiguous(stride_type::column_major);
+    if (row && col)
+        return 0u;
+    else if (row || col)
+        return layout_vote(row ? stride_type::row_major
+                               : stride_type::column_major);
+    return layout_vote(array.layout());
+}
+
+constexpr auto voted_layout(unsigned votes) noexcept {
+    return votes == layout_vote(stride_type::column_major)
+             ? stride_type::column_major
+             : stride_type::row_major;
+}
+
+// An expiring array can take the result of an element-wise operation in
+// place when it is contiguous, of the result type and nobody else refers to
+// its buffer.
+template<class Dt_, class Tp_>
+constexpr auto is_reusable(const Tp_& array) {
+    return std::same_as<typename Tp_::data_type, Dt_> && array.is_unique()
+        && array.is_contiguous();
 }
 
 } // namespace detail
@@ -272,9 +294,19 @@ template<class Tp1_,
          class Dt3_ = std::invoke_result_t<Fn_, Dt1_, Dt2_>,
          class Tp3_ = ndarray<Dt3_>>
     requires(!ndarray_like<Tp1_>) // Ensure no ndarray as scalar
-constexpr void broadcast(Tp1_ scalar, Tp2_&& arr1, Fn_&& func) {
-    detail::linear_walk(arr1.data(), arr1.data(), std::bind_front(func, scalar),
-                        arr1.size());
+constexpr Tp3_ broadcast(Tp1_ scalar, Tp2_&& arr1, Fn_&& func) {
+    if constexpr (std::same_as<Dt2_, Dt3_>) {
+        if (detail::is_reusable<Dt3_>(arr1)) {
+            auto span = trace::span("broadcast", arr1.size(),
+                                    arr1.size() * sizeof(Dt3_));
+            span.path("reused");
+            detail::parallel_linear_walk(arr1.data(), arr1.data(),
+                                         detail::bind_scalar {func, scalar},
+                                         arr1.size());
+            return std::move(arr1);
+        }
+    }
+    return broadcast(scalar, std::as_const(arr1), std::forward<Fn_>(func));
 }
 
 template<class Tp1_,
@@ -286,18 +318,13 @@ template<class Tp1_,
          class Tp3_ = ndarray<Dt3_>>
     requires(!ndarray_like<Tp1_>) // Ensure no ndarray as scalar
 constexpr auto broadcast(Tp1_ scalar, const Tp2_& arr1, Fn_&& func) {
-    auto arr2 = Tp3_(arr1.shape());
-    if (arr1.is_contiguous()) {
-        detail::linear_walk(arr2.data(), arr1.data(),
-                            std::bind_front(func, scalar), arr2.size());
-    } else {
-        auto&       strides = arr1.strides();
-        auto&       shape   = arr1.shape();
-        std::size_t idx     = 0;
-        detail::strided_walk(arr2.data(), arr1.data(),
-                             std::bind_front(func, scalar), shape.data(),
-                             strides.data(), arr2.rank(), idx);
-    }
+    auto arr2 = Tp3_(arr1.shape(), arr1.layout());
+    auto span = trace::span("broadcast", arr2.size(),
+                            arr2.size() * sizeof(Dt3_));
+    span.path("scalar");
+    detail::nest_walk(arr2.data(), arr1.data(),
+                      detail::bind_scalar {func, scalar}, arr1.shape(),
+                      arr2.strides(), arr1.strides());
     return arr2;
 }
 
@@ -308,32 +335,28 @@ template<ndarray_like Tp1_,
          class Dt2_ = Tp2_::data_type,
          class Dt3_ = std::invoke_result_t<Fn_, Dt1_, Dt2_>,
          class Tp3_ = ndarray<Dt3_>>
-constexpr void broadcast(Tp1_&& arr1, const Tp2_& arr2, Fn_&& func) {
-    ax_assert(arr1.size() >= arr2.size(),
-              "Cannot self broadcast array of larger size onto smaller array!");
-    // Check for scalar broadcasting
-    if (arr2.size() == 1) {
-        broadcast(arr2.data()[0], std::move(arr1), func);
-        return;
+constexpr Tp3_ broadcast(Tp1_&& arr1, const Tp2_& arr2, Fn_&& func) {
+    // The result goes to a new array unless arr1 can take it
+    if constexpr (std::same_as<Dt1_, Dt3_>) {
+        auto shape3 = detail::is_broadcastable_and_return_shape(arr1.shape(),
+                                                                arr2.shape());
+        if (detail::is_reusable<Dt3_>(arr1) && shape3 == arr1.shape()) {
+            // Check for scalar broadcasting
+            if (arr2.size() == 1)
+                return broadcast(arr2.data()[0], std::move(arr1),
+                                 detail::flip {func});
+
+            auto span = trace::span("broadcast", arr1.size(),
+                                    arr1.size() * sizeof(Dt3_));
+            span.path("reused");
+            detail::nest_walk(arr1.data(), arr1.data(), arr2.data(), func,
+                              shape3, arr1.strides(), arr1.strides(),
+                              detail::broadcast_strides(
+                                  arr2.shape(), arr2.strides(), shape3));
+            return std::move(arr1);
+        }
     }
-
-    detail::is_broadcastable(arr1.shape(), arr2.shape());
-
-    // Process the shape and strides to remove any dimension and corresponding
-    // stride that equals 1. If the corresponding rank is zero it means the
-    // array only contains a single value.
-    auto [vec, rank1, rank2] = detail::make_new_shape_strides(
-        arr1.shape(), arr2.shape(), arr1.strides(), arr2.strides());
-
-    auto shape1 = &vec[0];
-    auto shape2 = &vec[2 * arr1.rank()];
-
-    auto strides1 = &vec[arr1.rank()];
-    auto strides2 = &vec[2 * arr1.rank() + arr2.rank()];
-
-    detail::broadcast_helper(arr1.data(), arr1.data(), arr2.data(), func,
-                             shape1, shape2, strides1, strides2, rank1, rank2,
-                             arr1.size(), arr2.size());
+    return broadcast(std::as_const(arr1), arr2, std::forward<Fn_>(func));
 }
 
 template<ndarray_like Tp1_,
@@ -344,32 +367,30 @@ template<ndarray_like Tp1_,
          class Dt3_ = std::invoke_result_t<Fn_, Dt1_, Dt2_>,
          class Tp3_ = ndarray<Dt3_>>
 constexpr auto broadcast(const Tp1_& arr1, const Tp2_& arr2, Fn_&& func) {
-    // Check for scalar broadcasting
-    if (arr1.size() == 1)
-        return broadcast(arr1.data()[0], arr2, func);
-    else if (arr2.size() == 1)
-        return broadcast(arr2.data()[0], arr1, func);
-
     auto shape3
         = detail::is_broadcastable_and_return_shape(arr1.shape(), arr2.shape());
 
-    // Process the shape and strides to remove any dimension and corresponding
-    // stride that equals 1. If the corresponding rank is zero it means the
-    // array only contains a single value.
-    auto [vec2, rank1, rank2] = detail::make_new_shape_strides(
-        arr1.shape(), arr2.shape(), arr1.strides(), arr2.strides());
-
-    auto shape1 = &vec2[0];
-    auto shape2 = &vec2[2 * arr1.rank()];
-
-    auto strides1 = &vec2[arr1.rank()];
-    auto strides2 = &vec2[2 * arr1.rank() + arr2.rank()];
-
-    auto arr3 = Tp3_(shape3);
+    // Check for scalar broadcasting, whose result takes the leading axes of
+    // length one that the scalar has beyond the rank of the other operand
+    if (arr1.size() == 1 || arr2.size() == 1) {
+        auto arr3 = arr1.size() == 1
+                      ? broadcast(arr1.data()[0], arr2, func)
+                      : broadcast(arr2.data()[0], arr1, detail::flip {func});
+        if (arr3.rank() == shape3.size())
+            return arr3;
+        return arr3.reshape(shape3, arr3.layout());
+    }
 
-    detail::broadcast_helper(arr3.data(), arr1.data(), arr2.data(), func,
-                             shape1, shape2, strides1, strides2, rank1, rank2,
-                             arr1.size(), arr2.size());
+    auto votes  = detail::layout_votes(arr1, shape3)
+                | detail::layout_votes(arr2, shape3);
+    auto arr3   = Tp3_(shape3, detail::voted_layout(votes));
+    auto span   = trace::span("broadcast", arr3.size(),
+                              arr3.size() * sizeof(Dt3_));
+    auto merged = detail::nest_walk(
+        arr3.data(), arr1.data(), arr2.data(), func, shape3, arr3.strides(),
+        detail::broadcast_strides(arr1.shape(), arr1.strides(), shape3),
+        detail::broadcast_strides(arr2.shape(), arr2.strides(), shape3));
+    span.path(merged ? "linear" : "nest");
     return arr3;
 }
 
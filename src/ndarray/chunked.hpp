@@ -0,0 +1,357 @@
+#ifndef NDARRAY_CHUNKED_H_DEFINED
+#define NDARRAY_CHUNKED_H_DEFINED
+
+#include "../core.hpp"
+#include "broadcast.hpp"
+#include "core.hpp"
+#include "extrema.hpp"
+#include "math.hpp"
+#include "npy.hpp"
+#include "reduce.hpp"
+#include "summation.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace ax {
+
+namespace detail {
+
+// Default bound on the memory taken by the chunks of a chunked array that
+// are in flight at once.
+constexpr std::size_t chunk_budget = std::size_t(1) << 28;
+
+// Bytes per row along the leading axis of an array of the given shape, of
+// at least one element.
+template<class Tp_>
+constexpr auto row_bytes(const shape_type& shape) {
+    auto length = ranges::product(std::span(shape).subspan(1));
+    return std::max<std::size_t>(length, 1) * sizeof(Tp_);
+}
+
+// Rows per chunk out of count along the leading axis, such that the chunks
+// in flight at once fit in the budget when one row of each of them takes
+// bytes together.
+constexpr auto
+chunk_rows(std::size_t budget, std::size_t count, std::size_t bytes) {
+    return std::clamp<std::size_t>(budget / bytes, 1,
+                                   std::max<std::size_t>(count, 1));
+}
+
+// Calls func(read(first, rows), first) on consecutive ranges of rows along
+// the leading axis, count of them in all. The next range is read on another
+// thread while func processes the current one.
+template<class Rd_, class Fn_>
+inline void
+stream_chunks(std::size_t count, std::size_t rows, Rd_&& read, Fn_&& func) {
+    auto fetch = [&](std::size_t first) {
+        return std::async(std::launch::async, [&read, first, rows, count] {
+            return read(first, std::min(rows, count - first));
+        });
+    };
+    if (count == 0)
+        return;
+    auto next = fetch(0);
+    for (std::size_t first = 0; first < count; first += rows) {
+        auto chunk = next.get();
+        if (first + rows < count)
+            next = fetch(first + rows);
+        func(std::move(chunk), first);
+    }
+}
+
+} // namespace detail
+
+// An array that stays in an npy file in C order and is processed in chunks
+// of whole rows along its leading axis, so that it never has to fit in
+// memory. Chunks are sized so that the chunk being processed, the next one
+// being read ahead and a chunk of output fit in the memory budget. Files
+// that cannot be opened, read or written throw std::runtime_error.
+template<class Tp_>
+class chunked_array {
+ public:
+    using data_type = std::remove_cv_t<Tp_>;
+
+    constexpr auto& path() const noexcept {
+        return path_;
+    }
+
+    constexpr auto& shape() const noexcept {
+        return shape_;
+    }
+
+    constexpr auto rank() const noexcept {
+        return shape_.size();
+    }
+
+    constexpr auto size() const noexcept {
+        return ranges::product(shape_);
+    }
+
+    constexpr auto budget() const noexcept {
+        return budget_;
+    }
+
+    // Rows of the leading axis per chunk.
+    constexpr auto chunk_rows() const noexcept {
+        return rows_;
+    }
+
+    constexpr auto chunk_count() const noexcept {
+        return (shape_[0] + rows_ - 1) / rows_;
+    }
+
+    // Reads count rows of the leading axis starting at row first.
+    auto read(std::size_t first, std::size_t count) const {
+        ax_assert(first + count <= shape_[0], "Rows out of bounds!");
+        auto shape = shape_;
+        shape[0]   = count;
+        auto rows  = ndarray<data_type>(shape);
+        auto in    = std::ifstream(path_, std::ios::binary);
+        in.seekg(static_cast<std::streamoff>(position(first)));
+        in.read(reinterpret_cast<char*>(rows.data()),
+                static_cast<std::streamsize>(rows.size() * sizeof(data_type)));
+        detail::npy_check(in || rows.size() == 0, "Cannot read chunked array!");
+        if (swap_)
+            detail::byteswap(rows.data(), rows.size());
+        return rows;
+    }
+
+    auto chunk(std::size_t index) const {
+        auto first = index * rows_;
+        return read(first, std::min(rows_, shape_[0] - first));
+    }
+
+    // Writes rows of the leading axis starting at row first.
+    void write(std::size_t first, const ndarray<data_type>& rows) {
+        ax_assert(rows.rank() == rank()
+                      && std::equal(shape_.begin() + 1, shape_.end(),
+                                    rows.shape().begin() + 1)
+                      && first + rows.extent() <= shape_[0],
+                  "Rows do not fit in chunked array!");
+        detail::npy_check(!swap_,
+                          "Cannot write npy data of foreign byte order!");
+        if (!rows.is_contiguous(stride_type::row_major))
+            return write(first, rows.as_layout(stride_type::row_major));
+        auto out = std::fstream(path_, std::ios::in | std::ios::out
+                                           | std::ios::binary);
+        out.seekp(static_cast<std::streamoff>(position(first)));
+        out.write(reinterpret_cast<const char*>(rows.data()),
+                  static_cast<std::streamsize>(rows.size()
+                                               * sizeof(data_type)));
+        detail::npy_check(bool(out), "Cannot write chunked array!");
+    }
+
+    // Calls func(chunk, first) on every chunk in order, where first is the
+    // row at which the chunk starts. The chunk is passed as an rvalue so that
+    // its buffer can be reused for results.
+    template<class Fn_>
+    void for_each_chunk(Fn_&& func) const {
+        detail::stream_chunks(
+            shape_[0], rows_,
+            [this](std::size_t first, std::size_t count) {
+                return read(first, count);
+            },
+            std::forward<Fn_>(func));
+    }
+
+    // Creates an npy file for an array of the given shape, initially zero.
+    static auto create(const std::filesystem::path& path,
+                       const shape_type&            shape,
+                       std::size_t budget = detail::chunk_budget) {
+        ax_assert(shape.size() >= 1, "Cannot chunk an array of rank 0!");
+        auto out    = std::ofstream(path, std::ios::binary);
+        auto offset = detail::write_npy_header(
+            out, detail::npy_descr<data_type>(), false, shape);
+        out.close();
+        detail::npy_check(bool(out), "Cannot create chunked array!");
+        std::filesystem::resize_file(path, offset
+                                               + ranges::product(shape)
+                                                     * sizeof(data_type));
+        return chunked_array(path, budget);
+    }
+
+    explicit chunked_array(const std::filesystem::path& path,
+                           std::size_t budget = detail::chunk_budget)
+        : path_(path),
+          budget_(budget) {
+        auto in = std::ifstream(path, std::ios::binary);
+        detail::npy_check(bool(in), "Cannot open npy file!");
+        auto header = detail::read_npy_header(in);
+        detail::npy_check(!header.fortran_order || header.shape.size() < 2,
+                          "Cannot chunk an npy file in Fortran order!");
+        detail::npy_check(header.shape.size() >= 1,
+                          "Cannot chunk an array of rank 0!");
+        swap_   = detail::npy_byteswapped<data_type>(header);
+        shape_  = header.shape;
+        offset_ = header.offset;
+        length_ = ranges::product(std::span(shape_).subspan(1));
+
+        // Two chunks of input and one of output are in flight at once
+        rows_ = detail::chunk_rows(budget, shape_[0],
+                                   3 * detail::row_bytes<data_type>(shape_));
+    }
+
+ private:
+    std::filesystem::path path_;
+    shape_type            shape_;
+    std::size_t           offset_ = 0; // Of the data in the file
+    std::size_t           length_ = 0; // Elements per row
+    std::size_t           budget_ = 0;
+    std::size_t           rows_   = 1;
+    bool                  swap_   = false;
+
+    auto position(std::size_t row) const {
+        return offset_ + row * length_ * sizeof(data_type);
+    }
+};
+
+// Applies func to every element of a chunked array, writing the results to
+// a new npy file at path.
+template<class Tp_, class Fn_, class Tp2_ = std::invoke_result_t<Fn_, Tp_>>
+inline auto apply(const chunked_array<Tp_>&    array,
+                  const std::filesystem::path& path,
+                  Fn_&&                        func) {
+    auto result = chunked_array<Tp2_>::create(path, array.shape(),
+                                              array.budget());
+    array.for_each_chunk([&](ndarray<Tp_>&& chunk, std::size_t first) {
+        result.write(first, std::move(chunk).apply(func));
+    });
+    return result;
+}
+
+// Broadcasts func over a chunked array and an array that is read in full,
+// writing the results to a new npy file at path. The leading axis has to be
+// the one of the chunked array, so the other array has a lower rank or a
+// leading axis of length one.
+template<class Tp1_,
+         ndarray_like Tp2_,
+         class Fn_,
+         class Dt2_ = Tp2_::data_type,
+         class Dt3_ = std::invoke_result_t<Fn_, Tp1_, Dt2_>>
+inline auto broadcast(const chunked_array<Tp1_>&   arr1,
+                      const Tp2_&                  arr2,
+                      const std::filesystem::path& path,
+                      Fn_&&                        func) {
+    auto shape = detail::is_broadcastable_and_return_shape(arr1.shape(),
+                                                           arr2.shape());
+    ax_assert(arr2.rank() < arr1.rank()
+                  || (arr2.rank() == arr1.rank() && arr2.extent() == 1),
+              "Cannot broadcast along the leading axis of a chunked array!");
+    auto result = chunked_array<Dt3_>::create(path, shape, arr1.budget());
+
+    // Two chunks of arr1 and one of output, whose rows can be wider, are in
+    // flight at once
+    auto bytes = 2 * detail::row_bytes<Tp1_>(arr1.shape())
+               + detail::row_bytes<Dt3_>(shape);
+    detail::stream_chunks(
+        shape[0], detail::chunk_rows(arr1.budget(), shape[0], bytes),
+        [&](std::size_t first, std::size_t count) {
+            return arr1.read(first, count);
+        },
+        [&](ndarray<Tp1_>&& chunk, std::size_t first) {
+            result.write(first, broadcast(std::move(chunk), arr2, func));
+        });
+    return result;
+}
+
+// Broadcasts func over two chunked arrays of the same length along their
+// leading axis, which are read chunk by chunk together.
+template<class Tp1_,
+         class Tp2_,
+         class Fn_,
+         class Dt3_ = std::invoke_result_t<Fn_, Tp1_, Tp2_>>
+inline auto broadcast(const chunked_array<Tp1_>&   arr1,
+                      const chunked_array<Tp2_>&   arr2,
+                      const std::filesystem::path& path,
+                      Fn_&&                        func) {
+    auto shape = detail::is_broadcastable_and_return_shape(arr1.shape(),
+                                                           arr2.shape());
+    ax_assert(arr1.rank() == arr2.rank() && arr1.shape()[0] == arr2.shape()[0],
+              "Cannot broadcast along the leading axis of a chunked array!");
+    auto result = chunked_array<Dt3_>::create(path, shape, arr1.budget());
+
+    // Two chunks of each input and one of output are in flight at once
+    auto bytes = 2 * detail::row_bytes<Tp1_>(arr1.shape())
+               + 2 * detail::row_bytes<Tp2_>(arr2.shape())
+               + detail::row_bytes<Dt3_>(shape);
+    detail::stream_chunks(
+        shape[0], detail::chunk_rows(arr1.budget(), shape[0], bytes),
+        [&](std::size_t first, std::size_t count) {
+            return std::make_pair(arr1.read(first, count),
+                                  arr2.read(first, count));
+        },
+        [&](auto&& chunks, std::size_t first) {
+            result.write(first, broadcast(std::move(chunks.first),
+                                          chunks.second, func));
+        });
+    return result;
+}
+
+// Full-array reductions over the chunks of a chunked array. Partial results
+// of the chunks are combined with compensation for floating point types.
+template<class Tp_>
+inline auto sum(const chunked_array<Tp_>& array,
+                summation                 mode = summation::pairwise) {
+    auto result = detail::compensated_sum<Tp_>();
+    array.for_each_chunk([&](ndarray<Tp_>&& chunk, std::size_t) {
+        if constexpr (std::is_floating_point_v<Tp_>)
+            result.add(sum(chunk, mode));
+        else
+            result.sum += sum(chunk, mode);
+    });
+    return result.value();
+}
+
+template<class Tp_>
+inline auto mean(const chunked_array<Tp_>& array) {
+    using Rt_   = detail::floating_type<Tp_>;
+    auto result = detail::compensated_sum<Rt_>();
+    array.for_each_chunk([&](ndarray<Tp_>&& chunk, std::size_t) {
+        if constexpr (std::is_floating_point_v<Tp_>)
+            result.add(sum(chunk));
+        else
+            result.add(mean(chunk) * static_cast<Rt_>(chunk.size()));
+    });
+    return result.value() / static_cast<Rt_>(array.size());
+}
+
+template<class Tp_>
+inline auto minmax(const chunked_array<Tp_>& array,
+                   nan_policy                policy = nan_policy::propagate) {
+    ax_assert(array.size() > 0, "Cannot find minmax of array of size 0!");
+    auto result = detail::extrema_state<Tp_>();
+    array.for_each_chunk([&](ndarray<Tp_>&& chunk, std::size_t) {
+        auto state = detail::extrema<true, true>(chunk.data(), chunk.shape(),
+                                                 chunk.strides());
+        result.min = std::min(result.min, state.min);
+        result.max = std::max(result.max, state.max);
+        result.nans += state.nans;
+    });
+    return std::make_pair(
+        detail::apply_nan_policy(result.min, result.nans, array.size(), policy),
+        detail::apply_nan_policy(result.max, result.nans, array.size(),
+                                 policy));
+}
+
+template<class Tp_>
+inline auto min(const chunked_array<Tp_>& array,
+                nan_policy                policy = nan_policy::propagate) {
+    return minmax(array, policy).first;
+}
+
+template<class Tp_>
+inline auto max(const chunked_array<Tp_>& array,
+                nan_policy                policy = nan_policy::propagate) {
+    return minmax(array, policy).second;
+}
+
+} // namespace ax
+
+#endif /* NDARRAY_CHUNKED_H_DEFINED */
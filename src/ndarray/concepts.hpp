@@ -20,6 +20,28 @@ constexpr auto is_ndarray_v = is_ndarray<Tp_>::value;
 template<class Tp_>
 concept ndarray_like = is_ndarray_v<Tp_>;
 
+template<class Fn_, class... Ops_>
+class ndarray_expression;
+
+template<class>
+struct is_ndarray_expression : std::false_type {};
+
+template<class Fn_, class... Ops_>
+struct is_ndarray_expression<ndarray_expression<Fn_, Ops_...>> :
+    std::true_type {};
+
+template<class Tp_>
+constexpr auto is_ndarray_expression_v = is_ndarray_expression<Tp_>::value;
+
+template<class Tp_>
+concept expression_like = is_ndarray_expression_v<std::remove_cvref_t<Tp_>>;
+
+// Anything that can appear as an operand of the lazy arithmetic operators
+// and be evaluated into an ndarray.
+template<class Tp_>
+concept array_expression
+    = ndarray_like<std::remove_cvref_t<Tp_>> || expression_like<Tp_>;
+
 } // namespace ax
 
 #endif /* CONCEPTS_H_DEFINED */
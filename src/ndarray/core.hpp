@@ -3,13 +3,21 @@
 
 #include "../core.hpp"
 #include "broadcast.hpp"
+#include "expression.hpp"
 #include "extents.hpp"
 #include "iterator.hpp"
+#include "memory.hpp"
+#include "slice.hpp"
+#include "trace.hpp"
+#include "transpose.hpp"
 
+#include <atomic>
 #include <concepts>
 #include <cstdlib>
+#include <functional>
 #include <initializer_list>
 #include <memory>
+#include <utility>
 #include <vector>
 
 namespace ax {
@@ -94,34 +102,18 @@ constexpr void transpose_helper(const std::size_t*              old_shape,
     }
 }
 
-template<class Tp_>
-constexpr void reshape_helper(Tp_* const         data1,
-                              const Tp_* const   data2,
-                              const std::size_t* shape,
-                              const std::size_t* strides,
-                              std::size_t        nrank,
-                              std::size_t&       idx1,
-                              std::size_t        idx2 = 0) {
-    const auto stride = *strides;
-    const auto rank   = *shape;
-    if (nrank == 1) {
-        for (std::size_t i = 0; i < rank; ++i) {
-            data1[idx1++] = data2[idx2];
-            idx2 += stride;
-        }
-    } else {
-        shape++;
-        strides++;
-        nrank--;
-        for (std::size_t i = 0; i < rank; ++i) {
-            reshape_helper(data1, data2, shape, strides, nrank, idx1, idx2);
-            idx2 += stride;
-        }
-    }
-}
-
 } // namespace detail
 
+// Copies of an array share its buffer until either of them is written to,
+// a write being any mutable access: non-const operator[] and data(), fill and
+// compound assignment. Views share the buffer of their array for good, so
+// taking one from a mutable array that shares its buffer with copies first
+// gives the array a buffer of its own, while one taken from a const array
+// copies the buffer before its first write, so it never modifies the array.
+// Writes to the array itself still show in such a view. Copies of an array
+// that has views or is a strided view itself are made right away. A const
+// array is never modified, so any number of threads may read, copy and view
+// it at once.
 template<class Tp_>
 class ndarray {
  public:
@@ -129,46 +121,67 @@ class ndarray {
     using extent_type = ndarray_extents<stride_type::row_major>;
 
     constexpr auto extent(std::size_t rank = 0) const {
-        return extents_->extent(rank);
+        return extents_.extent(rank);
     }
 
     constexpr auto size() const noexcept {
-        return extents_->size();
+        return extents_.size();
     }
 
     constexpr auto rank() const noexcept {
-        return extents_->rank();
+        return extents_.rank();
     }
 
     constexpr auto& accessor() const noexcept {
         return data_;
     }
 
+    // Raw access that leaves a buffer shared with copies as it is, for reads
+    // and for writes to arrays that are known to own their buffer.
     constexpr auto data() const noexcept {
         return data_.get();
     }
 
+    constexpr auto data() {
+        detach();
+        return data_.get();
+    }
+
     constexpr auto& extents() const noexcept {
-        return *extents_;
+        return extents_;
+    }
+
+    constexpr auto layout() const noexcept {
+        return extents_.layout();
     }
 
+    // Contiguous in the layout of the array, or in the given order.
     constexpr auto is_contiguous() const noexcept {
-        return extents_->is_contiguous();
+        return extents_.is_contiguous();
+    }
+
+    constexpr auto is_contiguous(stride_type order) const {
+        return extents_.is_contiguous(order);
     }
 
     constexpr auto is_unique() const noexcept {
-        return data_.unique();
+        return data_.use_count() == 1;
     }
 
     constexpr auto& shape() const noexcept {
-        return extents_->shape();
+        return extents_.shape();
     }
 
     constexpr auto& strides() const noexcept {
-        return extents_->strides();
+        return extents_.strides();
     }
 
     constexpr void fill(Tp_ value) {
+        detach();
+        if (!is_contiguous()) {
+            apply_inplace([value](const data_type&) { return value; });
+            return;
+        }
         std::fill(data_.get(), data_.get() + size(), value);
     }
 
@@ -188,35 +201,84 @@ class ndarray {
         return ndarray_iterator(this, extent());
     }
 
-    template<class Fn_, class Tp2_ = std::invoke_result_t<Fn_, Tp_>>
-        requires(std::invocable<Fn_, data_type>)
-    constexpr auto apply(Fn_&& func) const {
-        auto array    = ndarray<Tp2_>(this->extents_->shape());
-        auto new_data = array.data();
-        auto old_data = this->data();
-        for (std::size_t i = 0; i < array.size(); ++i)
-            new_data[i] = func(old_data[i]);
+    // Maps func over the elements of the array, and the matching elements
+    // of any further operands broadcast against it, into a new array in a
+    // single pass. Any layout is walked correctly and large arrays are split
+    // across threads, so func may be called concurrently. Functors opted in
+    // through simd::vectorize run on registers, any other callable element
+    // by element. An expiring array lends its buffer to the result when the
+    // element type stays the same.
+    template<class Fn_, class... Ops_>
+        requires(std::invocable<const std::remove_cvref_t<Fn_>&,
+                                const data_type&,
+                                detail::operand_value_t<Ops_>...>)
+    constexpr auto apply(Fn_&& func, Ops_&&... operands) const& {
+        return detail::make_expression(std::forward<Fn_>(func), *this,
+                                       std::forward<Ops_>(operands)...)
+            .eval();
+    }
+
+    template<class Fn_, class... Ops_>
+        requires(std::invocable<const std::remove_cvref_t<Fn_>&,
+                                const data_type&,
+                                detail::operand_value_t<Ops_>...>)
+    constexpr auto apply(Fn_&& func, Ops_&&... operands) && {
+        return detail::make_expression(std::forward<Fn_>(func),
+                                       std::move(*this),
+                                       std::forward<Ops_>(operands)...)
+            .eval();
+    }
+
+    // Replaces each element by func of it and the matching elements of any
+    // further operands, which have to broadcast to the shape of the array.
+    template<class Fn_, class... Ops_>
+        requires(std::invocable<const std::remove_cvref_t<Fn_>&,
+                                const data_type&,
+                                detail::operand_value_t<Ops_>...>)
+    constexpr auto& apply_inplace(Fn_&& func, Ops_&&... operands) {
+        detach();
+        detail::assign(*this, detail::make_expression(
+                                  std::forward<Fn_>(func), std::as_const(*this),
+                                  std::forward<Ops_>(operands)...));
+        return *this;
+    }
+
+    // The array itself when it is contiguous in the given layout, a copy
+    // laid out that way otherwise.
+    constexpr auto as_layout(stride_type layout) const {
+        if (is_contiguous(layout))
+            return *this;
+        auto array = ndarray(extent_type(shape(), layout));
+        detail::materialize(array, *this);
         return array;
     }
 
-    constexpr auto reshape(const std::vector<std::size_t>& shape) const {
+    // Reads the elements in the given order and lays them out in the new
+    // shape in that same order, sharing the buffer when the array is
+    // contiguous in that order.
+    constexpr auto
+    reshape(const shape_type& shape,
+            stride_type       order = stride_type::row_major) const {
         ax_assert(ranges::product(shape) == size(),
                   "New shape does not match size of data!");
-        if (is_contiguous()) {
-            return ndarray(data_, shape);
-        } else {
-            auto        arr = ndarray<Tp_>(shape);
-            std::size_t idx = 0;
-            detail::reshape_helper(arr.data(), this->data(),
-                                   this->shape().data(), this->strides().data(),
-                                   this->rank(), idx);
-            return arr;
-        }
+        if (is_contiguous(order))
+            return share(data_, extent_type(shape, order));
+        const auto array = as_layout(order);
+        return array.reshape(shape, order);
+    }
+
+    constexpr auto reshape(const shape_type& shape,
+                           stride_type       order = stride_type::row_major) {
+        detach();
+        return write_through(std::as_const(*this).reshape(shape, order));
     }
 
-    constexpr auto flatten() const {
-        std::vector<std::size_t> shape = {size()};
-        return reshape(shape);
+    constexpr auto flatten(stride_type order = stride_type::row_major) const {
+        return reshape({size()}, order);
+    }
+
+    constexpr auto flatten(stride_type order = stride_type::row_major) {
+        return reshape({size()}, order);
     }
 
     constexpr auto transpose(const std::vector<std::size_t>& axes) const {
@@ -225,44 +287,74 @@ class ndarray {
                   "Number of axes does not match rank of array!");
         for (auto& x : axes)
             ax_assert(x < rank(), "Axis cannot exceed rank of array!");
-        auto old_shape   = extents_->shape().data();
-        auto old_strides = extents_->strides().data();
-        auto new_shape   = std::vector<std::size_t>(rank());
-        auto new_strides = std::vector<std::size_t>(rank());
+        auto old_shape   = extents_.shape().data();
+        auto old_strides = extents_.strides().data();
+        auto new_shape   = shape_type(rank());
+        auto new_strides = shape_type(rank());
         detail::transpose_helper(old_shape, old_strides, new_shape.data(),
                                  new_strides.data(), 0, axes);
-        auto new_extents = extent_type(new_shape, new_strides, size(), false);
-        auto array       = ndarray(data_, new_extents);
-        return array;
+        return share(data_, extent_type(new_shape, new_strides, size()));
+    }
+
+    constexpr auto transpose(const std::vector<std::size_t>& axes) {
+        detach();
+        return write_through(std::as_const(*this).transpose(axes));
     }
 
     constexpr auto transpose() const {
         ax_assert(rank() >= 2, "Cannot transpose array less than rank 2!");
         auto idx     = rank();
-        auto shape   = extents_->shape();
-        auto strides = extents_->strides();
+        auto shape   = extents_.shape();
+        auto strides = extents_.strides();
         std::swap(shape[idx - 1], shape[idx - 2]);
         std::swap(strides[idx - 1], strides[idx - 2]);
-        auto new_extents = extent_type(shape, strides, size(), false);
-        auto array       = ndarray(data_, new_extents);
-        return array;
+        return share(data_, extent_type(shape, strides, size()));
+    }
+
+    constexpr auto transpose() {
+        detach();
+        return write_through(std::as_const(*this).transpose());
     }
 
     template<std::integral... Its_>
         requires(sizeof...(Its_) >= 1)
     constexpr auto view(Its_... idxs) const {
-        auto  flat_idx  = extents_->index(idxs...);
+        auto  flat_idx  = extents_.index(idxs...);
         auto  data_ptr  = std::shared_ptr<data_type[]>(data_, &data_[flat_idx]);
-        auto& old_shape = extents_->shape();
-        auto& old_strides = extents_->strides();
+        auto& old_shape = extents_.shape();
+        auto& old_strides = extents_.strides();
         auto  new_shape
-            = std::vector(old_shape.begin() + sizeof...(Its_), old_shape.end());
-        auto new_strides = std::vector(old_strides.begin() + sizeof...(Its_),
-                                       old_strides.end());
-        auto new_extents
-            = extent_type(new_shape, new_strides, ranges::product(new_shape),
-                          is_contiguous());
-        return ndarray(data_ptr, new_extents);
+            = shape_type(old_shape.begin() + sizeof...(Its_), old_shape.end());
+        auto new_strides = shape_type(old_strides.begin() + sizeof...(Its_),
+                                      old_strides.end());
+        auto new_extents = extent_type(new_shape, new_strides,
+                                       ranges::product(new_shape));
+        return share(data_ptr, new_extents);
+    }
+
+    template<std::integral... Its_>
+        requires(sizeof...(Its_) >= 1)
+    constexpr auto view(Its_... idxs) {
+        detach();
+        return write_through(std::as_const(*this).view(idxs...));
+    }
+
+    // View of part of the array that shares its buffer, one index per axis:
+    // an integer picks a position and drops the axis, a range keeps the
+    // positions it walks, newaxis inserts an axis of length one and ellipsis
+    // stands for whole axes. Axes left over at the end are kept whole.
+    template<slice_index... Ix_>
+    constexpr auto slice(const Ix_&... idxs) const {
+        auto [extents, offset] = detail::slice_extents(shape(), strides(),
+                                                       idxs...);
+        auto data_ptr = std::shared_ptr<data_type[]>(data_, &data_[offset]);
+        return share(data_ptr, extents);
+    }
+
+    template<slice_index... Ix_>
+    constexpr auto slice(const Ix_&... idxs) {
+        detach();
+        return write_through(std::as_const(*this).slice(idxs...));
     }
 
     ndarray() = default;
@@ -271,30 +363,68 @@ class ndarray {
         *this = other;
     }
 
-    ndarray(ndarray<Tp_>&& other) noexcept {
-        *this = std::move(other);
+    ndarray(ndarray<Tp_>&& other) noexcept
+        : extents_(std::exchange(other.extents_, extent_type())),
+          data_(std::move(other.data_)),
+          shared_(other.shared_.exchange(false)) {
+    }
+
+    explicit ndarray(const Tp_* ptr, const shape_type& shape)
+        : extents_(shape),
+          data_(allocate(extents_.size(), "ndarray(pointer, shape)")) {
+        std::copy(ptr, ptr + extents_.size(), data_.get());
     }
 
-    explicit ndarray(const Tp_* ptr, const std::vector<std::size_t>& shape)
-        : extents_(std::make_unique<extent_type>(shape)),
-          data_(std::shared_ptr<Tp_[]>(new Tp_[extents_->size()])) {
-        std::copy(ptr, ptr + extents_->size(), data_.get());
+    explicit ndarray(const shape_type& shape)
+        : extents_(shape),
+          data_(allocate(extents_.size(), "ndarray(shape)")) {
     }
 
-    explicit ndarray(const std::vector<std::size_t>& shape)
-        : extents_(std::make_unique<extent_type>(shape)),
-          data_(std::shared_ptr<Tp_[]>(new Tp_[extents_->size()])) {
+    explicit ndarray(const shape_type& shape, stride_type layout)
+        : extents_(shape, layout),
+          data_(allocate(extents_.size(), "ndarray(shape, layout)")) {
     }
 
-    explicit ndarray(Tp_ value, const std::vector<std::size_t>& shape)
-        : extents_(std::make_unique<extent_type>(shape)),
-          data_(std::shared_ptr<Tp_[]>(new Tp_[extents_->size()])) {
+    explicit ndarray(Tp_ value, const shape_type& shape)
+        : extents_(shape),
+          data_(allocate(extents_.size(), "ndarray(value, shape)")) {
         fill(value);
     }
 
     explicit ndarray(const extent_type& extents)
-        : extents_(std::make_unique<extent_type>(extents)),
-          data_(std::shared_ptr<Tp_[]>(new Tp_[extents.size()])) {
+        : extents_(extents),
+          data_(allocate(extents.size(), "ndarray(extents)")) {
+    }
+
+    // Wraps a buffer that is owned elsewhere, such as a memory mapped file,
+    // the deleter of data_ptr releasing it with the last array that uses it.
+    explicit ndarray(const std::shared_ptr<data_type[]>& data_ptr,
+                     const extent_type&                  extents)
+        : extents_(extents),
+          data_(data_ptr) {
+    }
+
+    // Evaluates a lazy expression into a newly allocated array, this is the
+    // point at which arithmetic such as a + b * c actually runs. The result
+    // takes the layout of the operands, see ndarray_expression::layout().
+    template<expression_like Ex_>
+    ndarray(const Ex_& expr)
+        : extents_(expr.shape(), expr.layout()),
+          data_(allocate(extents_.size(), "ndarray(expression)")) {
+        detail::evaluate(*this, expr);
+    }
+
+    // An expiring expression such as ax::exp(a) * b writes its result over
+    // a temporary array it owns whenever one can take it.
+    template<expression_like Ex_>
+        requires(!std::is_lvalue_reference_v<Ex_>)
+    ndarray(Ex_&& expr)
+        : extents_(expr.shape(), expr.layout()),
+          data_(expr.template reusable_buffer<data_type>(expr.shape(),
+                                                         expr.layout())) {
+        if (!data_)
+            data_ = allocate(size(), "ndarray(expression)");
+        detail::evaluate(*this, expr);
     }
 
     template<std::size_t N_>
@@ -322,141 +452,132 @@ class ndarray {
 
     template<std::integral... Its_>
         requires(sizeof...(Its_) >= 1)
-    constexpr auto& operator[](Its_... idxs) const {
-        ax_assert(sizeof...(Its_) == rank(), "Incorrect number of indices!");
-        detail::verify_indices(extents_->shape().data(), idxs...);
-        auto flat_idx = extents_->index(idxs...);
-        return data_[flat_idx];
+    constexpr const auto& operator[](Its_... idxs) const {
+        return element(idxs...);
+    }
+
+    template<std::integral... Its_>
+        requires(sizeof...(Its_) >= 1)
+    constexpr auto& operator[](Its_... idxs) {
+        detach();
+        return element(idxs...);
     }
 
     constexpr auto& operator=(const ndarray<Tp_>& other) {
-        auto size = other.size();
-        extents_  = std::make_unique<extent_type>(other.extents());
-        data_     = std::shared_ptr<Tp_[]>(new Tp_[size]);
-        std::copy(other.data(), other.data() + size, data_.get());
+        if (this == &other)
+            return *this;
+        shared_ = false;
+        if (!other.is_contiguous()) {
+            extents_ = extent_type(other.shape(), other.layout());
+            data_    = allocate(size(), "copy of view");
+            detail::materialize(*this, other);
+        } else if (other.shared_ || other.is_unique()) {
+            extents_      = other.extents();
+            data_         = other.data_;
+            shared_       = true;
+            other.shared_ = true;
+        } else {
+            extents_ = other.extents();
+            data_    = allocate(size(), "copy of array with views");
+            std::copy(other.data(), other.data() + size(), data_.get());
+        }
         return *this;
     }
 
     constexpr auto& operator=(ndarray<data_type>&& other) noexcept {
-        extents_ = std::make_unique<extent_type>(other.extents());
-        data_    = other.accessor();
+        if (this == &other)
+            return *this;
+        extents_ = std::exchange(other.extents_, extent_type());
+        data_    = std::move(other.data_);
+        shared_  = other.shared_.exchange(false);
         return *this;
     }
 
-    template<class Tp2_>
-    constexpr auto operator+(const ndarray<Tp2_>& arr) {
-        return broadcast(*this, arr, std::plus());
-    }
-
-    template<class Tp2_>
-    constexpr auto operator+(Tp2_ scalar) {
-        return broadcast(scalar, *this, std::plus());
-    }
-
-    template<class Tp2_>
-    constexpr auto operator-(const ndarray<Tp2_>& arr) {
-        return broadcast(*this, arr, std::minus());
-    }
-
-    template<class Tp2_>
-    constexpr auto operator-(Tp2_ scalar) {
-        return broadcast(scalar, *this, std::minus());
-    }
-
-    template<class Tp2_>
-    constexpr auto operator*(const ndarray<Tp2_>& arr) {
-        return broadcast(*this, arr, std::multiplies());
-    }
-
-    template<class Tp2_>
-    constexpr auto operator*(Tp2_ scalar) {
-        return broadcast(scalar, *this, std::multiplies());
-    }
-
-    template<class Tp2_>
-    constexpr auto operator/(const ndarray<Tp2_>& arr) {
-        return broadcast(*this, arr, std::divides());
-    }
-
-    template<class Tp2_>
-    constexpr auto operator/(Tp2_ scalar) {
-        return broadcast(scalar, *this, std::divides());
+    template<expression_like Ex_>
+    constexpr auto& operator=(Ex_&& expr) {
+        return *this = ndarray(std::forward<Ex_>(expr));
     }
 
     template<class Tp2_>
-    constexpr auto& operator+=(const ndarray<Tp2_>& arr) {
-        broadcast(std::move(*this), arr, std::plus());
-        return *this;
+    constexpr auto& operator+=(Tp2_&& other) {
+        return apply_inplace(std::plus(), std::forward<Tp2_>(other));
     }
 
     template<class Tp2_>
-    constexpr auto& operator+=(Tp2_ scalar) {
-        broadcast(scalar, std::move(*this), std::plus());
-        return *this;
+    constexpr auto& operator-=(Tp2_&& other) {
+        return apply_inplace(std::minus(), std::forward<Tp2_>(other));
     }
 
     template<class Tp2_>
-    constexpr auto& operator-=(const ndarray<Tp2_>& arr) {
-        broadcast(std::move(*this), arr, std::minus());
-        return *this;
+    constexpr auto& operator*=(Tp2_&& other) {
+        return apply_inplace(std::multiplies(), std::forward<Tp2_>(other));
     }
 
     template<class Tp2_>
-    constexpr auto& operator-=(Tp2_ scalar) {
-        broadcast(scalar, std::move(*this), std::minus());
-        return *this;
+    constexpr auto& operator/=(Tp2_&& other) {
+        return apply_inplace(std::divides(), std::forward<Tp2_>(other));
     }
 
-    template<class Tp2_>
-    constexpr auto& operator*=(const ndarray<Tp2_>& arr) {
-        broadcast(std::move(*this), arr, std::multiplies());
-        return *this;
-    }
-
-    template<class Tp2_>
-    constexpr auto& operator*=(Tp2_ scalar) {
-        broadcast(scalar, std::move(*this), std::multiplies());
-        return *this;
+ private:
+    extent_type                  extents_;
+    std::shared_ptr<data_type[]> data_;
+    mutable std::atomic<bool>    shared_ = false; // With copies
+
+    // Buffer of size elements for the named constructor or copy, recorded
+    // when tracing.
+    static auto allocate(std::size_t size, const char* origin) {
+        trace::record_allocation(origin, size * sizeof(data_type));
+        return detail::allocate_buffer<data_type>(size);
+    }
+
+    // Gives an array that shares its buffer with copies a buffer of its own,
+    // unless the copies are gone by now.
+    constexpr void detach() {
+        if (!shared_.exchange(false) || is_unique())
+            return;
+        auto copy = ndarray(allocate(size(), "copy on write"),
+                            extent_type(shape(), layout()));
+        detail::materialize(copy, *this);
+        extents_ = copy.extents_;
+        data_    = std::move(copy.data_);
+    }
+
+    // Array over part of the buffer that copies it before its first write,
+    // so that writing to it never reaches this array. This array is left
+    // unmarked, as reading it through views must not cut it off from the
+    // views it has.
+    constexpr auto share(const std::shared_ptr<data_type[]>& data_ptr,
+                         const extent_type&                  extents) const {
+        auto array    = ndarray(data_ptr, extents);
+        array.shared_ = true;
+        return array;
     }
 
-    template<class Tp2_>
-    constexpr auto& operator/=(const ndarray<Tp2_>& arr) {
-        broadcast(std::move(*this), arr, std::divides());
-        return *this;
+    // Turns an array made by share() into a view that writes through to
+    // this array.
+    static constexpr auto write_through(ndarray&& array) {
+        array.shared_ = false;
+        return std::move(array);
     }
 
-    template<class Tp2_>
-    constexpr auto& operator/=(Tp2_ scalar) {
-        broadcast(scalar, std::move(*this), std::divides());
-        return *this;
+    template<std::integral... Its_>
+    constexpr auto& element(Its_... idxs) const {
+        ax_assert(sizeof...(Its_) == rank(), "Incorrect number of indices!");
+        detail::verify_indices(extents_.shape().data(), idxs...);
+        auto flat_idx = extents_.index(idxs...);
+        return data_[flat_idx];
     }
 
- private:
-    std::unique_ptr<extent_type> extents_;
-    std::shared_ptr<data_type[]> data_;
-
     template<std::size_t N_>
     constexpr void init_from_nl(const Nl_<N_>& data) {
         std::vector<std::size_t> shape;
         std::size_t              size;
         detail::shape_from_nested_init_list<data_type, N_>(data, shape, size);
-        data_    = std::shared_ptr<Tp_[]>(new Tp_[size]);
-        extents_ = std::make_unique<extent_type>(shape, size);
+        data_    = allocate(size, "ndarray(initializer list)");
+        extents_ = extent_type(shape, size);
         detail::data_from_nested_init_list<data_type, N_>(data, data_.get(),
                                                           shape);
     }
-
-    explicit ndarray(const std::shared_ptr<data_type[]>& data_ptr,
-                     const std::vector<std::size_t>&     shape)
-        : extents_(std::make_unique<extent_type>(shape)),
-          data_(data_ptr) {
-    }
-
-    explicit ndarray(const std::shared_ptr<data_type[]>& data_ptr,
-                     const extent_type&                  extents)
-        : extents_(std::make_unique<extent_type>(extents)),
-          data_(data_ptr) {
-    }
 };
 
 } // namespace ax
@@ -0,0 +1,529 @@
+#ifndef NDARRAY_EXPRESSION_H_DEFINED
+#define NDARRAY_EXPRESSION_H_DEFINED
+
+#include "../core.hpp"
+#include "broadcast.hpp"
+#include "concepts.hpp"
+#include "kernels.hpp"
+#include "layout.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <memory>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ax {
+
+namespace detail {
+
+// Cursors hold the evaluation state of an operand. An expression tree is
+// turned into a matching tree of cursors which is positioned on one row of
+// the loop nest of the output at a time with seek() and then indexed along
+// the innermost axis of the nest.
+template<class Tp_>
+class scalar_cursor {
+ public:
+    constexpr void seek(const std::size_t*) noexcept {
+    }
+
+    constexpr auto operator()(std::size_t) const noexcept {
+        return value_;
+    }
+
+    template<class Bt_>
+    auto load(std::size_t) const noexcept {
+        return Bt_::broadcast(static_cast<typename Bt_::value_type>(value_));
+    }
+
+    constexpr explicit scalar_cursor(Tp_ value)
+        : value_(value) {
+    }
+
+ private:
+    Tp_ value_;
+};
+
+template<class Tp_>
+class array_cursor {
+ public:
+    constexpr void seek(const std::size_t* idxs) noexcept {
+        row_ = data_ + flat_index(idxs, strides_.data(), strides_.size());
+    }
+
+    constexpr auto operator()(std::size_t idx) const noexcept {
+        return row_[static_cast<std::ptrdiff_t>(idx) * stride_];
+    }
+
+    template<class Bt_>
+    auto load(std::size_t idx) const noexcept {
+        return Bt_::load_strided(
+            row_ + static_cast<std::ptrdiff_t>(idx) * stride_, stride_);
+    }
+
+    // Strides are those of the array along the loop nest.
+    constexpr array_cursor(const Tp_* data, const shape_type& strides)
+        : data_(data),
+          stride_(static_cast<std::ptrdiff_t>(strides.back())),
+          strides_(strides) {
+    }
+
+ private:
+    const Tp_*     data_;
+    const Tp_*     row_    = nullptr;
+    std::ptrdiff_t stride_ = 0;
+    shape_type     strides_;
+};
+
+template<class Fn_, class... Cs_>
+class expression_cursor {
+ public:
+    constexpr void seek(const std::size_t* idxs) noexcept {
+        std::apply([&](auto&... cursor) { (cursor.seek(idxs), ...); },
+                   cursors_);
+    }
+
+    constexpr auto operator()(std::size_t idx) const {
+        return std::apply(
+            [&](const auto&... cursor) { return (*func_)(cursor(idx)...); },
+            cursors_);
+    }
+
+    template<class Bt_>
+    auto load(std::size_t idx) const {
+        return std::apply(
+            [&](const auto&... cursor) {
+                return simd::invoke(*func_, cursor.template load<Bt_>(idx)...);
+            },
+            cursors_);
+    }
+
+    constexpr explicit expression_cursor(const Fn_* func, Cs_... cursors)
+        : func_(func),
+          cursors_(std::move(cursors)...) {
+    }
+
+ private:
+    const Fn_*          func_;
+    std::tuple<Cs_...> cursors_;
+};
+
+template<class Tp_>
+class scalar_operand {
+ public:
+    using value_type = Tp_;
+
+    // Scalars are converted to the register type, which matches the usual
+    // arithmetic conversions whenever the parent yields that type.
+    template<class Vt_>
+    static constexpr bool vectorizable_as = std::is_arithmetic_v<Tp_>;
+
+    constexpr auto shape() const noexcept {
+        return shape_type();
+    }
+
+    constexpr void
+    gather_strides(const shape_type&, std::vector<shape_type>&) const noexcept {
+    }
+
+    constexpr auto layout_votes(const shape_type&) const noexcept {
+        return 0u;
+    }
+
+    template<class Tp2_>
+    constexpr auto aliases(const ndarray<Tp2_>&) const noexcept {
+        return false;
+    }
+
+    template<class Tp2_>
+    constexpr auto
+    reusable_buffer(const shape_type&, stride_type) const noexcept {
+        return std::shared_ptr<Tp2_[]>();
+    }
+
+    constexpr auto
+    cursor(const loop_nest&, const shape_type&) const noexcept {
+        return scalar_cursor<Tp_>(value_);
+    }
+
+    constexpr explicit scalar_operand(Tp_ value)
+        : value_(value) {
+    }
+
+ private:
+    Tp_ value_;
+};
+
+// Lvalue arrays are referenced, rvalue arrays are moved into the expression
+// so that temporaries such as ax::sin(a) live as long as the expression.
+template<class Ar_>
+class array_operand {
+ public:
+    using array_type = std::remove_cvref_t<Ar_>;
+    using value_type = typename array_type::data_type;
+
+    template<class Vt_>
+    static constexpr bool vectorizable_as = std::same_as<value_type, Vt_>;
+
+    constexpr auto& shape() const noexcept {
+        return array_.shape();
+    }
+
+    // Appends the strides of the array broadcast to the output shape.
+    constexpr void gather_strides(const shape_type&        shape,
+                                  std::vector<shape_type>& strides) const {
+        strides.push_back(
+            broadcast_strides(array_.shape(), array_.strides(), shape));
+    }
+
+    constexpr auto layout_votes(const shape_type& shape) const {
+        return detail::layout_votes(array_, shape);
+    }
+
+    // An operand aliases the destination when it reads the same buffer
+    // through a different layout, writing in place would then clobber
+    // elements that are yet to be read.
+    template<class Tp2_>
+    constexpr auto aliases(const ndarray<Tp2_>& dest) const {
+        auto& owner1 = array_.accessor();
+        auto& owner2 = dest.accessor();
+        if (owner1.owner_before(owner2) || owner2.owner_before(owner1))
+            return false;
+        return static_cast<const void*>(array_.data())
+                   != static_cast<const void*>(dest.data())
+            || array_.shape() != dest.shape()
+            || array_.strides() != dest.strides();
+    }
+
+    // An array owned by an expiring expression can hand its buffer over to
+    // the output when it is contiguous with the output shape, layout and
+    // type and nothing else refers to it. Each element is then read just
+    // before it is overwritten.
+    template<class Tp2_>
+    constexpr auto
+    reusable_buffer(const shape_type& shape, stride_type layout) const {
+        if constexpr (!std::is_reference_v<Ar_>
+                      && std::same_as<value_type, Tp2_>) {
+            if (is_reusable<Tp2_>(array_) && array_.shape() == shape
+                && array_.is_contiguous(layout))
+                return std::shared_ptr<Tp2_[]>(array_.accessor());
+        }
+        return std::shared_ptr<Tp2_[]>();
+    }
+
+    constexpr auto
+    cursor(const loop_nest& nest, const shape_type& shape) const {
+        return array_cursor<value_type>(
+            array_.data(),
+            nest.strides(
+                broadcast_strides(array_.shape(), array_.strides(), shape)));
+    }
+
+    template<class Tp_>
+    constexpr explicit array_operand(Tp_&& array)
+        : array_(std::forward<Tp_>(array)) {
+    }
+
+ private:
+    Ar_ array_;
+};
+
+template<class Tp_>
+constexpr auto make_operand(Tp_&& operand) {
+    using Dt_ = std::remove_cvref_t<Tp_>;
+    if constexpr (expression_like<Dt_>)
+        return Dt_(std::forward<Tp_>(operand));
+    else if constexpr (ndarray_like<Dt_> && std::is_lvalue_reference_v<Tp_>)
+        return array_operand<const Dt_&>(operand);
+    else if constexpr (ndarray_like<Dt_>)
+        return array_operand<Dt_>(std::move(operand));
+    else
+        return scalar_operand<Dt_>(operand);
+}
+
+// Element type that an operand contributes to an expression.
+template<class Tp_>
+using operand_value_t =
+    typename decltype(make_operand(std::declval<Tp_>()))::value_type;
+
+} // namespace detail
+
+// A lazily evaluated element-wise operation. Operands are broadcast against
+// each other when the node is built but no data is touched until the node is
+// assigned to an ndarray or eval() is called, at which point the whole tree
+// is evaluated in a single pass over the output.
+template<class Fn_, class... Ops_>
+class ndarray_expression {
+ public:
+    using value_type = std::remove_cvref_t<
+        std::invoke_result_t<const Fn_&, typename Ops_::value_type...>>;
+
+    // True when the whole tree can be evaluated on registers of Vt_, i.e.
+    // every node yields Vt_ and every functor is vectorized for batches.
+    template<class Vt_>
+    static constexpr bool vectorizable_as
+        = std::same_as<value_type, Vt_>
+       && simd::vectorizable_op<Fn_, Vt_, sizeof...(Ops_)>
+       && (Ops_::template vectorizable_as<Vt_> && ...);
+
+    constexpr auto& shape() const noexcept {
+        return shape_;
+    }
+
+    constexpr auto size() const {
+        return ranges::product(shape_);
+    }
+
+    constexpr auto rank() const noexcept {
+        return shape_.size();
+    }
+
+    constexpr void gather_strides(const shape_type&        shape,
+                                  std::vector<shape_type>& strides) const {
+        std::apply(
+            [&](const auto&... operand) {
+                (operand.gather_strides(shape, strides), ...);
+            },
+            operands_);
+    }
+
+    constexpr auto layout_votes(const shape_type& shape) const {
+        return std::apply(
+            [&](const auto&... operand) {
+                return (0u | ... | operand.layout_votes(shape));
+            },
+            operands_);
+    }
+
+    // Layout of the result, column-major when some operand of the full
+    // shape is column-major and none is row-major, so that column-major
+    // inputs give column-major outputs.
+    constexpr auto layout() const {
+        return detail::voted_layout(layout_votes(shape_));
+    }
+
+    template<class Tp_>
+    constexpr auto aliases(const ndarray<Tp_>& dest) const {
+        return std::apply(
+            [&](const auto&... operand) {
+                return (operand.aliases(dest) || ...);
+            },
+            operands_);
+    }
+
+    // Buffer of the first operand that can take the output in place, empty
+    // when there is none.
+    template<class Tp_>
+    constexpr auto
+    reusable_buffer(const shape_type& shape, stride_type layout) const {
+        auto result = std::shared_ptr<Tp_[]>();
+        std::apply(
+            [&](const auto&... operand) {
+                (void)(... || (result = operand.template reusable_buffer<Tp_>(
+                                   shape, layout)));
+            },
+            operands_);
+        return result;
+    }
+
+    constexpr auto
+    cursor(const detail::loop_nest& nest, const shape_type& shape) const {
+        return std::apply(
+            [&](const auto&... operand) {
+                return detail::expression_cursor(
+                    &func_, operand.cursor(nest, shape)...);
+            },
+            operands_);
+    }
+
+    constexpr auto eval() const& {
+        return ndarray<value_type>(*this);
+    }
+
+    constexpr auto eval() && {
+        return ndarray<value_type>(std::move(*this));
+    }
+
+    constexpr explicit ndarray_expression(Fn_ func, Ops_... operands)
+        : func_(std::move(func)),
+          operands_(std::move(operands)...) {
+        std::apply(
+            [&](const auto&... operand) { (broadcast_shape(operand), ...); },
+            operands_);
+    }
+
+ private:
+    Fn_                 func_;
+    std::tuple<Ops_...> operands_;
+    shape_type          shape_;
+
+    template<class Op_>
+    constexpr void broadcast_shape(const Op_& operand) {
+        const auto& shape = operand.shape();
+        if (shape.empty())
+            return;
+        else if (shape_.empty())
+            shape_ = shape;
+        else
+            shape_ = detail::is_broadcastable_and_return_shape(shape_, shape);
+    }
+};
+
+namespace detail {
+
+template<class Fn_, class... Tps_>
+constexpr auto make_expression(Fn_&& func, Tps_&&... operands) {
+    return ndarray_expression(std::forward<Fn_>(func),
+                              make_operand(std::forward<Tps_>(operands))...);
+}
+
+// Evaluates entries [first, last) of one row of the output. Contiguous rows
+// of trees that can run on registers go through the SIMD batches, with a
+// scalar head up to the first aligned store and a scalar tail.
+template<class Ex_, class Tp_, class Cs_>
+inline void evaluate_row(Tp_* const     data,
+                         const Cs_&     cursor,
+                         std::size_t    first,
+                         std::size_t    last,
+                         std::ptrdiff_t stride) {
+    if constexpr (Ex_::template vectorizable_as<Tp_>) {
+        if (stride == 1) {
+            using batch = simd::batch<Tp_>;
+            auto i = first + std::min(simd::alignment_offset(data + first),
+                                      last - first);
+            for (auto j = first; j < i; ++j)
+                data[j] = cursor(j);
+            for (; i + batch::size <= last; i += batch::size)
+                cursor.template load<batch>(i).store_aligned(data + i);
+            for (; i < last; ++i)
+                data[i] = cursor(i);
+            return;
+        }
+    }
+#pragma omp simd
+    for (auto i = first; i < last; ++i)
+        data[static_cast<std::ptrdiff_t>(i) * stride] = cursor(i);
+}
+
+// Path evaluate() takes through a loop nest, for tracing: a single loop
+// over contiguous operands, a single loop with some operand strided, or
+// nested loops, either of the last two with or without an operand broadcast
+// along the nest.
+inline const char* evaluate_path(const loop_nest&            nest,
+                                 std::span<const shape_type> strides) {
+    auto linear    = nest.rank() == 1;
+    auto broadcast = false;
+    for (auto& s : strides) {
+        auto along = nest.strides(s);
+        linear     = linear && (along.back() == 1 || nest.inner() == 1);
+        for (std::size_t i = 0; i < nest.rank(); ++i)
+            broadcast = broadcast || (along[i] == 0 && nest.shape()[i] > 1);
+    }
+    if (linear)
+        return "linear";
+    if (nest.rank() == 1)
+        return broadcast ? "broadcast_strided" : "strided";
+    return broadcast ? "broadcast_loop_nest" : "loop_nest";
+}
+
+// Evaluates an expression into the memory of an existing array of the same
+// shape. The output and every array in the tree are walked as one loop nest
+// in the memory order of the output, a single flat loop when they are all
+// contiguous alike. Large outputs are split across threads, each with its
+// own cursors.
+template<class Tp_, expression_like Ex_>
+constexpr void evaluate(const ndarray<Tp_>& dest, const Ex_& expr) {
+    ax_assert(dest.shape() == expr.shape(),
+              "Cannot assign expression to array of different shape!");
+    auto  data  = dest.data();
+    auto& shape = dest.shape();
+    auto  span  = trace::span("evaluate", dest.size(),
+                              dest.size() * sizeof(Tp_));
+    if (dest.size() == 0)
+        return;
+
+    auto strides = std::vector<shape_type> {dest.strides()};
+    expr.gather_strides(shape, strides);
+    auto nest    = loop_nest(shape, strides);
+    if constexpr (trace::enabled)
+        span.path(evaluate_path(nest, strides));
+    auto dstride = std::array {nest.strides(dest.strides())};
+    auto inner   = nest.inner();
+    auto stride  = static_cast<std::ptrdiff_t>(dstride[0].back());
+    if (nest.rank() == 1) {
+        parallel_for(
+            inner, 1,
+            [&](std::size_t first, std::size_t last) {
+                auto cursor = expr.cursor(nest, shape);
+                auto origin = shape_type(nest.rank(), 0);
+                cursor.seek(origin.data());
+                evaluate_row<Ex_>(data, cursor, first, last, stride);
+            },
+            line_grain<Tp_>);
+        return;
+    }
+
+    parallel_for(nest.rows(), inner, [&](std::size_t first, std::size_t last) {
+        auto cursor = expr.cursor(nest, shape);
+        walk_rows(nest.shape(), dstride, first, last,
+                  [&](const auto& idxs, const auto& offsets) {
+                      cursor.seek(idxs.data());
+                      evaluate_row<Ex_>(data + offsets[0], cursor, 0, inner,
+                                        stride);
+                  });
+    });
+}
+
+template<class Tp_, expression_like Ex_>
+constexpr void assign(const ndarray<Tp_>& dest, const Ex_& expr) {
+    if (expr.aliases(dest)) {
+        auto temp = ndarray<typename Ex_::value_type>(expr);
+        evaluate(dest, make_expression(std::identity(), temp));
+    } else
+        evaluate(dest, expr);
+}
+
+} // namespace detail
+
+template<class Tp1_, class Tp2_>
+    requires(array_expression<Tp1_> || array_expression<Tp2_>)
+constexpr auto operator+(Tp1_&& lhs, Tp2_&& rhs) {
+    return detail::make_expression(std::plus(), std::forward<Tp1_>(lhs),
+                                   std::forward<Tp2_>(rhs));
+}
+
+template<class Tp1_, class Tp2_>
+    requires(array_expression<Tp1_> || array_expression<Tp2_>)
+constexpr auto operator-(Tp1_&& lhs, Tp2_&& rhs) {
+    return detail::make_expression(std::minus(), std::forward<Tp1_>(lhs),
+                                   std::forward<Tp2_>(rhs));
+}
+
+template<class Tp1_, class Tp2_>
+    requires(array_expression<Tp1_> || array_expression<Tp2_>)
+constexpr auto operator*(Tp1_&& lhs, Tp2_&& rhs) {
+    return detail::make_expression(std::multiplies(), std::forward<Tp1_>(lhs),
+                                   std::forward<Tp2_>(rhs));
+}
+
+template<class Tp1_, class Tp2_>
+    requires(array_expression<Tp1_> || array_expression<Tp2_>)
+constexpr auto operator/(Tp1_&& lhs, Tp2_&& rhs) {
+    return detail::make_expression(std::divides(), std::forward<Tp1_>(lhs),
+                                   std::forward<Tp2_>(rhs));
+}
+
+template<array_expression Tp_>
+constexpr auto operator-(Tp_&& operand) {
+    return detail::make_expression(std::negate(), std::forward<Tp_>(operand));
+}
+
+} // namespace ax
+
+#endif /* NDARRAY_EXPRESSION_H_DEFINED */
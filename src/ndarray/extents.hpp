@@ -1,9 +1,13 @@
 #ifndef EXTENTS_H_DEFINED
 #define EXTENTS_H_DEFINED
 
+#include "../containers/static_vector.hpp"
 #include "../ranges/numeric.hpp"
 
+#include <algorithm>
+#include <cstddef>
 #include <numeric>
+#include <span>
 #include <vector>
 
 namespace ax {
@@ -13,27 +17,25 @@ enum class stride_type : int {
     column_major
 };
 
-namespace detail {
+// Highest rank an ndarray can have, shape and strides are stored inline up
+// to this size.
+constexpr std::size_t max_rank = 8;
 
-constexpr auto is_strided_same(const std::size_t* strides1,
-                               const std::size_t* strides2,
-                               std::size_t        rank1,
-                               std::size_t        rank2) {
-    auto ptr1 = &strides1[rank1 - 1];
-    auto ptr2 = &strides2[rank2 - 1];
-    for (std::size_t i = 0; i < std::min(rank1, rank2); ++i)
-        if (*(ptr1--) != *(ptr2--))
-            return false;
-    return true;
-}
+using shape_type = static_vector<std::size_t, max_rank>;
 
+namespace detail {
+
+// Strides are unsigned, a negative stride such as that of a slice with a
+// negative step wraps around. Offsets summed from strides wrap the same way
+// and come out right once read back as signed, as they are whenever they
+// are applied to a pointer.
 constexpr auto flat_index(const std::size_t* indices,
                           const std::size_t* strides,
                           const std::size_t  size) noexcept {
     std::size_t result = 0;
     for (std::size_t i = 0; i < size; ++i)
         result += indices[i] * strides[i];
-    return result;
+    return static_cast<std::ptrdiff_t>(result);
 }
 
 template<std::integral It_, std::integral... Its_>
@@ -46,12 +48,57 @@ constexpr auto flat_index(std::size_t&       result,
         flat_index(result, strideptr + 1, rest...);
 }
 
+// Whether the strides lay the shape out densely in the given order. Axes of
+// length one may have any stride and empty arrays are always dense.
+constexpr auto is_dense(std::span<const std::size_t> shape,
+                        std::span<const std::size_t> strides,
+                        stride_type                  order) {
+    if (std::ranges::find(shape, 0) != shape.end())
+        return true;
+    auto        rank   = shape.size();
+    std::size_t stride = 1;
+    for (std::size_t n = 0; n < rank; ++n) {
+        auto i = order == stride_type::row_major ? rank - n - 1 : n;
+        if (shape[i] != 1 && strides[i] != stride)
+            return false;
+        stride *= shape[i];
+    }
+    return true;
+}
+
+// Distance in elements between neighbours along an axis, whatever the
+// direction of its stride.
+constexpr auto stride_length(std::size_t stride) noexcept {
+    auto value = static_cast<std::ptrdiff_t>(stride);
+    return static_cast<std::size_t>(value < 0 ? -value : value);
+}
+
+// Layout closest to the strides, column-major when the first axis longer
+// than one has a shorter stride than the last. Arrays with fewer than two
+// such axes count as row-major.
+constexpr auto layout_of(std::span<const std::size_t> shape,
+                         std::span<const std::size_t> strides) {
+    auto axes = shape_type();
+    for (std::size_t i = 0; i < shape.size(); ++i)
+        if (shape[i] != 1)
+            axes.push_back(i);
+    if (axes.size() < 2)
+        return stride_type::row_major;
+    return stride_length(strides[axes.front()])
+                   < stride_length(strides[axes.back()])
+             ? stride_type::column_major
+             : stride_type::row_major;
+}
+
 } // namespace detail
 
+// Shape and strides of an array. Extents built from a shape get dense
+// strides in the layout asked for, St_ by default, while extents built from
+// strides detect the layout and whether they are contiguous in it.
 template<stride_type St_ = stride_type::row_major>
 class ndarray_extents {
  public:
-    static constexpr auto stride_type = St_;
+    static constexpr auto default_layout = St_;
 
     constexpr auto extent(std::size_t rank = 0) const {
         return shape_.at(rank);
@@ -73,20 +120,26 @@ class ndarray_extents {
         return strides_;
     }
 
-    constexpr void set_conguitity(bool contiguity) noexcept {
-        contiguity_ = contiguity;
+    constexpr auto layout() const noexcept {
+        return layout_;
     }
 
+    // Contiguous in the layout of the extents.
     constexpr auto is_contiguous() const noexcept {
         return contiguity_;
     }
 
+    constexpr auto is_contiguous(stride_type order) const {
+        return order == layout_ ? contiguity_
+                                : detail::is_dense(shape_, strides_, order);
+    }
+
     template<std::integral... Its_>
         requires(sizeof...(Its_) >= 1)
     constexpr auto index(Its_... idxs) const {
         std::size_t index = 0;
         detail::flat_index(index, strides_.data(), idxs...);
-        return index;
+        return static_cast<std::ptrdiff_t>(index);
     }
 
     template<std::integral It_>
@@ -94,44 +147,42 @@ class ndarray_extents {
         return detail::flat_index(idxs.data(), strides_.data(), rank());
     }
 
-    ndarray_extents(const std::vector<std::size_t>& shape)
+    ndarray_extents() = default;
+
+    constexpr ndarray_extents(std::span<const std::size_t> shape)
         : shape_(shape),
           strides_(shape.size()),
           size_(ranges::product(shape)) {
         update_strides();
     }
 
-    ndarray_extents(const std::vector<std::size_t>& shape, std::size_t size)
+    constexpr ndarray_extents(std::span<const std::size_t> shape,
+                              stride_type                  layout)
+        : shape_(shape),
+          strides_(shape.size()),
+          size_(ranges::product(shape)),
+          layout_(layout) {
+        update_strides();
+    }
+
+    constexpr ndarray_extents(std::span<const std::size_t> shape,
+                              std::size_t                  size)
         : shape_(shape),
           strides_(shape.size()),
           size_(size) {
         update_strides();
     }
 
-    ndarray_extents(const std::vector<std::size_t>& shape,
-                    const std::vector<std::size_t>& strides,
-                    std::size_t                     size,
-                    bool                            contiguity = true)
+    constexpr ndarray_extents(std::span<const std::size_t> shape,
+                              std::span<const std::size_t> strides,
+                              std::size_t                  size)
         : shape_(shape),
           strides_(strides),
           size_(size),
-          contiguity_(contiguity) {
-    }
-
-    constexpr auto& operator=(const ndarray_extents& other) {
-        shape_      = other.shape();
-        strides_    = other.strides();
-        size_       = other.size();
-        contiguity_ = other.is_contiguous();
-        return *this;
+          layout_(detail::layout_of(shape, strides)),
+          contiguity_(detail::is_dense(shape, strides, layout_)) {
     }
 
-    ndarray_extents(const ndarray_extents& extents) {
-        *this = extents;
-    }
-
-    ndarray_extents(ndarray_extents&& extents) = delete;
-
     template<std::integral... Sz_>
     constexpr ndarray_extents(Sz_... shape)
         : shape_({static_cast<std::size_t>(shape)...}),
@@ -141,14 +192,19 @@ class ndarray_extents {
     }
 
  private:
-    std::vector<std::size_t> shape_;
-    std::vector<std::size_t> strides_;
-    std::size_t              size_;
-    bool                     contiguity_ = true;
+    shape_type  shape_;
+    shape_type  strides_;
+    std::size_t size_       = 0;
+    stride_type layout_     = St_;
+    bool        contiguity_ = true;
 
     constexpr void update_strides() {
-        std::exclusive_scan(shape_.rbegin(), shape_.rend(), strides_.rbegin(),
-                            1, std::multiplies());
+        if (layout_ == stride_type::row_major)
+            std::exclusive_scan(shape_.rbegin(), shape_.rend(),
+                                strides_.rbegin(), 1, std::multiplies());
+        else
+            std::exclusive_scan(shape_.begin(), shape_.end(), strides_.begin(),
+                                1, std::multiplies());
     }
 };
 
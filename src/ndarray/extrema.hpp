@@ -0,0 +1,257 @@
+#ifndef NDARRAY_EXTREMA_H_DEFINED
+#define NDARRAY_EXTREMA_H_DEFINED
+
+#include "../simd/batch.hpp"
+#include "layout.hpp"
+#include "memory.hpp"
+#include "parallel.hpp"
+#include "reduce.hpp"
+#include "trace.hpp"
+
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+namespace ax {
+
+namespace detail {
+
+template<class Tp_>
+struct extrema_state {
+    Tp_         min  = highest<Tp_>();
+    Tp_         max  = lowest<Tp_>();
+    std::size_t nans = 0;
+};
+
+// Folds count elements spaced stride apart into the running minimum and/or
+// maximum with two register accumulators per extreme. NaN lanes are counted
+// on the side so that the accumulators themselves never hold a NaN.
+template<bool Min_, bool Max_, class Tp_>
+inline void extrema_kernel(extrema_state<Tp_>& state,
+                           const Tp_* const    data,
+                           std::size_t         count,
+                           std::ptrdiff_t      stride) {
+    std::size_t i = 0;
+    if constexpr (simd::vectorizable<Tp_>) {
+        using batch = simd::batch<Tp_>;
+        auto w      = static_cast<std::ptrdiff_t>(batch::size);
+        auto n      = static_cast<std::ptrdiff_t>(count);
+        auto lo0    = batch::broadcast(state.min);
+        auto lo1    = lo0;
+        auto hi0    = batch::broadcast(state.max);
+        auto hi1    = hi0;
+        auto nans   = typename batch::mask_type {};
+        auto fold   = [&](const batch& value, batch& lo, batch& hi) {
+            if constexpr (Min_)
+                lo = min(lo, value);
+            if constexpr (Max_)
+                hi = max(hi, value);
+            if constexpr (std::is_floating_point_v<Tp_>)
+                nans -= isnan(value);
+        };
+        auto j = std::ptrdiff_t(0);
+        for (; j + 2 * w <= n; j += 2 * w) {
+            auto ptr = data + j * stride;
+            fold(batch::load_strided(ptr, stride), lo0, hi0);
+            fold(batch::load_strided(ptr + w * stride, stride), lo1, hi1);
+        }
+        for (; j + w <= n; j += w)
+            fold(batch::load_strided(data + j * stride, stride), lo0, hi0);
+        lo0 = min(lo0, lo1);
+        hi0 = max(hi0, hi1);
+        for (std::size_t k = 0; k < batch::size; ++k) {
+            if (lo0[k] < state.min)
+                state.min = lo0[k];
+            if (hi0[k] > state.max)
+                state.max = hi0[k];
+            state.nans += static_cast<std::size_t>(nans[k]);
+        }
+        i = static_cast<std::size_t>(j);
+    }
+    for (; i < count; ++i) {
+        auto value = data[static_cast<std::ptrdiff_t>(i) * stride];
+        if (Min_ && value < state.min)
+            state.min = value;
+        if (Max_ && value > state.max)
+            state.max = value;
+        if (is_nan(value))
+            state.nans++;
+    }
+}
+
+// Minimum and/or maximum of an array in any layout. Large arrays are split
+// into blocks across threads.
+template<bool Min_, bool Max_, class Tp_>
+inline auto extrema(const Tp_* const  data,
+                    const shape_type& shape,
+                    const shape_type& strides) {
+    auto blocks      = row_blocks(shape, strides);
+    auto stride      = blocks.stride();
+    auto count       = ranges::product(shape);
+    auto span        = trace::span("extrema", count, count * sizeof(Tp_));
+    auto block_state = [&](std::size_t block) {
+        auto state = extrema_state<Tp_> {};
+        blocks.visit(data, block, [&](auto ptr, auto count, auto) {
+            extrema_kernel<Min_, Max_>(state, ptr, count, stride);
+        });
+        return state;
+    };
+
+    auto nblocks = blocks.size();
+    span.path(stride == 1 ? "contiguous" : "strided");
+    if (nblocks <= 1)
+        return nblocks ? block_state(0) : extrema_state<Tp_> {};
+
+    auto partials = allocate_buffer<extrema_state<Tp_>>(nblocks);
+    parallel_for(nblocks, scan_block_size,
+                 [&](std::size_t first, std::size_t last) {
+                     for (auto i = first; i < last; ++i)
+                         partials[i] = block_state(i);
+                 });
+    auto result = partials[0];
+    for (std::size_t i = 1; i < nblocks; ++i) {
+        if (partials[i].min < result.min)
+            result.min = partials[i].min;
+        if (partials[i].max > result.max)
+            result.max = partials[i].max;
+        result.nans += partials[i].nans;
+    }
+    return result;
+}
+
+// Replaces an extreme by NaN according to the policy, which also covers an
+// array of nothing but NaN.
+template<class Tp_>
+constexpr auto apply_nan_policy(Tp_         value,
+                                std::size_t nans,
+                                std::size_t size,
+                                nan_policy  policy) {
+    if constexpr (std::numeric_limits<Tp_>::has_quiet_NaN)
+        if (nans && (policy == nan_policy::propagate || nans == size))
+            return std::numeric_limits<Tp_>::quiet_NaN();
+    return value;
+}
+
+template<bool Max_, class Tp_>
+constexpr auto arg_better(const Tp_& value, const arg_state<Tp_>& state) {
+    if (state.index == no_index)
+        return true;
+    return Max_ ? value > state.value : value < state.value;
+}
+
+// Folds count elements spaced stride apart, the first of which is at
+// position pos, into the running extreme and its index. Each register lane
+// tracks its own extreme and position, lanes holding NaN take the next
+// element so that NaN is only left behind when a lane sees nothing else.
+template<bool Max_, class Tp_>
+inline void arg_kernel(arg_state<Tp_>&  state,
+                       bool&            nan,
+                       const Tp_* const data,
+                       std::size_t      count,
+                       std::ptrdiff_t   stride,
+                       std::size_t      pos) {
+    auto fold = [&](const Tp_& value, std::size_t idx) {
+        if (is_nan(value))
+            nan = true;
+        else if (arg_better<Max_>(value, state)
+                 || (value == state.value && idx < state.index))
+            state = {value, idx};
+    };
+
+    std::size_t i = 0;
+    if constexpr (simd::vectorizable<Tp_>) {
+        using batch = simd::batch<Tp_>;
+        using index = typename batch::mask_type;
+        using lane  = std::remove_cvref_t<decltype(index {}[0])>;
+        auto w      = static_cast<std::ptrdiff_t>(batch::size);
+        auto n      = static_cast<std::ptrdiff_t>(count);
+        if (n >= w && n <= std::numeric_limits<lane>::max()) {
+            auto current = index {};
+            for (std::size_t k = 0; k < batch::size; ++k)
+                current[k] = static_cast<lane>(k);
+            auto best = batch::load_strided(data, stride).native();
+            auto idxs = current;
+            auto nans = best != best;
+            auto j    = w;
+            for (; j + w <= n; j += w) {
+                current += static_cast<lane>(w);
+                auto value = batch::load_strided(data + j * stride, stride)
+                                 .native();
+                auto mask  = Max_ ? value > best : value < best;
+                if constexpr (std::is_floating_point_v<Tp_>) {
+                    mask |= best != best;
+                    nans |= value != value;
+                }
+                best = mask ? value : best;
+                idxs = mask ? current : idxs;
+            }
+            for (std::size_t k = 0; k < batch::size; ++k) {
+                fold(best[k], pos + static_cast<std::size_t>(idxs[k]));
+                if (nans[k])
+                    nan = true;
+            }
+            i = static_cast<std::size_t>(j);
+        }
+    }
+    for (; i < count; ++i)
+        fold(data[static_cast<std::ptrdiff_t>(i) * stride], pos + i);
+}
+
+// Row-major index of the minimum or maximum of an array in any layout. The
+// array is walked in row-major order, split into blocks across threads, and
+// the blocks are combined in order. When propagating NaN the first block
+// holding one is rescanned for its first NaN.
+template<bool Max_, class Tp_>
+inline auto arg_extremum(const Tp_* const  data,
+                         const shape_type& shape,
+                         const shape_type& strides,
+                         nan_policy        policy) {
+    auto blocks      = row_blocks(shape, strides, false);
+    auto stride      = blocks.stride();
+    auto nblocks     = blocks.size();
+    auto count       = ranges::product(shape);
+    auto span        = trace::span("arg_extremum", count, count * sizeof(Tp_));
+    span.path(stride == 1 ? "contiguous" : "strided");
+    auto block_state = [&](std::size_t block, bool& nan) {
+        auto state = arg_state<Tp_> {};
+        blocks.visit(data, block, [&](auto ptr, auto count, auto pos) {
+            arg_kernel<Max_>(state, nan, ptr, count, stride, pos);
+        });
+        return state;
+    };
+
+    auto partials = allocate_buffer<arg_state<Tp_>>(nblocks);
+    auto nans     = allocate_buffer<bool>(nblocks);
+    parallel_for(nblocks, scan_block_size,
+                 [&](std::size_t first, std::size_t last) {
+                     for (auto i = first; i < last; ++i) {
+                         nans[i]     = false;
+                         partials[i] = block_state(i, nans[i]);
+                     }
+                 });
+
+    auto result = arg_state<Tp_> {};
+    for (std::size_t i = 0; i < nblocks; ++i) {
+        if (policy == nan_policy::propagate && nans[i]) {
+            auto index = no_index;
+            blocks.visit(data, i, [&](auto ptr, auto count, auto pos) {
+                for (std::size_t j = 0; j < count && index == no_index; ++j)
+                    if (is_nan(ptr[static_cast<std::ptrdiff_t>(j) * stride]))
+                        index = pos + j;
+            });
+            return index;
+        }
+        auto& state = partials[i];
+        if (state.index != no_index
+            && (arg_better<Max_>(state.value, result)
+                || (state.value == result.value && state.index < result.index)))
+            result = state;
+    }
+    return result.index;
+}
+
+} // namespace detail
+
+} // namespace ax
+
+#endif /* NDARRAY_EXTREMA_H_DEFINED */
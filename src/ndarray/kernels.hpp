@@ -0,0 +1,154 @@
+#ifndef NDARRAY_KERNELS_H_DEFINED
+#define NDARRAY_KERNELS_H_DEFINED
+
+#include "../simd/batch.hpp"
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <type_traits>
+
+namespace ax {
+
+namespace detail {
+
+// Binds a scalar as the left operand of a binary functor. Unlike
+// std::bind_front the bound value stays visible to the kernels, which
+// broadcast it into a register once instead of per element.
+template<class Fn_, class Tp_>
+struct bind_scalar {
+    Fn_ func;
+    Tp_ value;
+
+    template<class Tp2_>
+    constexpr auto operator()(const Tp2_& arg) const {
+        if constexpr (simd::is_batch_v<Tp2_>)
+            return simd::invoke(func, Tp2_::broadcast(value), arg);
+        else
+            return func(value, arg);
+    }
+};
+
+// Swaps the operands of a binary functor, used when the kernels walk the
+// operands of a broadcast in the opposite order to the call.
+template<class Fn_>
+struct flip {
+    Fn_ func;
+
+    template<class Tp1_, class Tp2_>
+    constexpr auto operator()(const Tp1_& lhs, const Tp2_& rhs) const {
+        return simd::invoke(func, rhs, lhs);
+    }
+};
+
+} // namespace detail
+
+} // namespace ax
+
+namespace ax::simd {
+
+// The wrappers run on batches whenever the functor they wrap does.
+template<class Fn_, class Tp_>
+struct is_vectorized<ax::detail::bind_scalar<Fn_, Tp_>>
+    : is_vectorized<Fn_> {};
+
+template<class Fn_>
+struct is_vectorized<ax::detail::flip<Fn_>> : is_vectorized<Fn_> {};
+
+} // namespace ax::simd
+
+namespace ax {
+
+namespace detail {
+
+// The SIMD kernels are used when every operand and the result share one
+// vectorizable type and the functor can be run on registers of that type.
+// Mixed types and arbitrary callables take the scalar loops.
+template<class Fn_, class Tp1_, class... Tps_>
+concept simd_kernel
+    = (std::same_as<Tp1_, Tps_> && ...)
+   && std::same_as<std::invoke_result_t<const Fn_&, const Tps_&...>, Tp1_>
+   && simd::vectorizable_op<Fn_, Tp1_, sizeof...(Tps_)>;
+
+// Each kernel runs a scalar head until the output is aligned to a full
+// register, stores whole registers with aligned stores and finishes the
+// remainder with a scalar tail. Inputs are loaded unaligned (or gathered
+// when strided) since their alignment relative to the output is arbitrary.
+template<class Tp_, class Fn_>
+inline void simd_linear_kernel(Tp_* const       data1,
+                               const Tp_* const data2,
+                               const Fn_&       func,
+                               std::size_t      size) {
+    using batch = simd::batch<Tp_>;
+    auto i      = std::min(simd::alignment_offset(data1), size);
+    for (std::size_t j = 0; j < i; ++j)
+        data1[j] = func(data2[j]);
+    for (; i + batch::size <= size; i += batch::size)
+        simd::invoke(func, batch::load(data2 + i)).store_aligned(data1 + i);
+    for (; i < size; ++i)
+        data1[i] = func(data2[i]);
+}
+
+template<class Tp_, class Fn_>
+inline void simd_linear_kernel(Tp_* const       data1,
+                               const Tp_* const data2,
+                               const Tp_* const data3,
+                               const Fn_&       func,
+                               std::size_t      size) {
+    using batch = simd::batch<Tp_>;
+    auto i      = std::min(simd::alignment_offset(data1), size);
+    for (std::size_t j = 0; j < i; ++j)
+        data1[j] = func(data2[j], data3[j]);
+    for (; i + batch::size <= size; i += batch::size)
+        simd::invoke(func, batch::load(data2 + i), batch::load(data3 + i))
+            .store_aligned(data1 + i);
+    for (; i < size; ++i)
+        data1[i] = func(data2[i], data3[i]);
+}
+
+template<class Tp_, class Fn_>
+inline void simd_strided_kernel(Tp_* const       data1,
+                                const Tp_* const data2,
+                                const Fn_&       func,
+                                std::size_t      size,
+                                std::ptrdiff_t   stride2) {
+    using batch = simd::batch<Tp_>;
+    auto n      = static_cast<std::ptrdiff_t>(size);
+    auto w      = static_cast<std::ptrdiff_t>(batch::size);
+    auto i      = std::min<std::ptrdiff_t>(simd::alignment_offset(data1), n);
+    for (std::ptrdiff_t j = 0; j < i; ++j)
+        data1[j] = func(data2[j * stride2]);
+    for (; i + w <= n; i += w)
+        simd::invoke(func, batch::load_strided(data2 + i * stride2, stride2))
+            .store_aligned(data1 + i);
+    for (; i < n; ++i)
+        data1[i] = func(data2[i * stride2]);
+}
+
+template<class Tp_, class Fn_>
+inline void simd_strided_kernel(Tp_* const       data1,
+                                const Tp_* const data2,
+                                const Tp_* const data3,
+                                const Fn_&       func,
+                                std::size_t      size,
+                                std::ptrdiff_t   stride2,
+                                std::ptrdiff_t   stride3) {
+    using batch = simd::batch<Tp_>;
+    auto n      = static_cast<std::ptrdiff_t>(size);
+    auto w      = static_cast<std::ptrdiff_t>(batch::size);
+    auto i      = std::min<std::ptrdiff_t>(simd::alignment_offset(data1), n);
+    for (std::ptrdiff_t j = 0; j < i; ++j)
+        data1[j] = func(data2[j * stride2], data3[j * stride3]);
+    for (; i + w <= n; i += w)
+        simd::invoke(func, batch::load_strided(data2 + i * stride2, stride2),
+                     batch::load_strided(data3 + i * stride3, stride3))
+            .store_aligned(data1 + i);
+    for (; i < n; ++i)
+        data1[i] = func(data2[i * stride2], data3[i * stride3]);
+}
+
+} // namespace detail
+
+} // namespace ax
+
+#endif /* NDARRAY_KERNELS_H_DEFINED */
@@ -0,0 +1,211 @@
+#ifndef NDARRAY_LAYOUT_H_DEFINED
+#define NDARRAY_LAYOUT_H_DEFINED
+
+#include "extents.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <utility>
+
+namespace ax {
+
+namespace detail {
+
+// Elements per block of a full-array scan. Blocks are fixed by the layout of
+// the array alone, so scans that combine the results of their blocks in
+// order do not depend on how many threads computed them.
+constexpr std::size_t scan_block_size = std::size_t(1) << 14;
+
+// Loop nest over a shape that several operands walk together, each with
+// strides of its own that are zero along the axes it is broadcast over.
+// Unit axes are dropped and with reorder the others are sorted by
+// decreasing stride length of the first operand, ties going by the next
+// ones, so the first operand is walked in memory order, backwards along
+// axes of negative stride. Neighbouring axes that every
+// operand steps through as one are then merged. The last axis is the
+// innermost loop and at least one axis is kept.
+class loop_nest {
+ public:
+    constexpr auto rank() const noexcept {
+        return shape_.size();
+    }
+
+    constexpr auto& shape() const noexcept {
+        return shape_;
+    }
+
+    // Length of the innermost loop and number of times it runs.
+    constexpr auto inner() const noexcept {
+        return shape_.back();
+    }
+
+    constexpr auto rows() const {
+        auto size = ranges::product(shape_);
+        return size == 0 ? 0 : size / inner();
+    }
+
+    // Strides of an operand along the axes of the nest.
+    constexpr auto strides(const shape_type& strides) const {
+        auto result = shape_type(rank(), 0);
+        for (std::size_t i = 0; i < rank(); ++i)
+            if (axes_[i] != no_axis)
+                result[i] = strides[axes_[i]];
+        return result;
+    }
+
+    loop_nest(const shape_type&           shape,
+              std::span<const shape_type> strides,
+              bool                        reorder = true) {
+        auto order = shape_type();
+        for (std::size_t i = 0; i < shape.size(); ++i)
+            if (shape[i] != 1)
+                order.push_back(i);
+        if (reorder)
+            std::stable_sort(order.begin(), order.end(),
+                             [&](auto lhs, auto rhs) {
+                                 for (auto& s : strides) {
+                                     auto l = stride_length(s[lhs]);
+                                     auto r = stride_length(s[rhs]);
+                                     if (l != r)
+                                         return l > r;
+                                 }
+                                 return false;
+                             });
+
+        for (auto i : order) {
+            auto merge = !shape_.empty();
+            for (auto& s : strides)
+                merge = merge && s[axes_.back()] == shape[i] * s[i];
+            if (merge) {
+                shape_.back() *= shape[i];
+                axes_.back() = i;
+            } else {
+                shape_.push_back(shape[i]);
+                axes_.push_back(i);
+            }
+        }
+        if (shape_.empty()) {
+            shape_.push_back(1);
+            axes_.push_back(no_axis);
+        }
+    }
+
+ private:
+    static constexpr auto no_axis = static_cast<std::size_t>(-1);
+
+    shape_type shape_;
+    shape_type axes_; // Innermost original axis of each axis of the nest
+};
+
+// Calls func(idxs, offsets) for rows [first, last) of a loop nest, in the
+// order of the nest. idxs are the indices of the first element of the row,
+// zero along the innermost axis, and offsets hold the position of that
+// element in each operand given its strides along the nest.
+template<std::size_t N_, class Fn_>
+inline void walk_rows(const shape_type&                shape,
+                      const std::array<shape_type, N_>& strides,
+                      std::size_t                      first,
+                      std::size_t                      last,
+                      Fn_&&                            func) {
+    auto rank    = shape.size();
+    auto outer   = std::max<std::size_t>(rank, 1) - 1;
+    auto idxs    = shape_type(rank, 0);
+    auto offsets = std::array<std::ptrdiff_t, N_> {};
+    for (auto i = outer, n = first; i-- > 0; n /= shape[i])
+        idxs[i] = n % shape[i];
+    for (std::size_t k = 0; k < N_; ++k)
+        offsets[k] = flat_index(idxs.data(), strides[k].data(), rank);
+
+    for (auto n = first; n < last; ++n) {
+        func(std::as_const(idxs), std::as_const(offsets));
+        for (auto i = outer; i-- > 0;) {
+            for (std::size_t k = 0; k < N_; ++k)
+                offsets[k] += static_cast<std::ptrdiff_t>(strides[k][i]);
+            if (++idxs[i] < shape[i])
+                break;
+            for (std::size_t k = 0; k < N_; ++k)
+                offsets[k] -= static_cast<std::ptrdiff_t>(shape[i]
+                                                          * strides[k][i]);
+            idxs[i] = 0;
+        }
+    }
+}
+
+// Partition of the rows of an array into blocks of about scan_block_size
+// elements. Long rows are split into several blocks and short rows are
+// grouped into one.
+class row_blocks {
+ public:
+    // Number of blocks, zero for an empty array.
+    constexpr auto size() const noexcept {
+        return size_;
+    }
+
+    constexpr auto stride() const noexcept {
+        return stride_;
+    }
+
+    // Calls func(ptr, count, pos) for every run of count elements spaced
+    // stride() apart in the block, where pos is the position of the first
+    // element in walk order (row-major order unless reordered).
+    template<class Tp_, class Fn_>
+    void visit(const Tp_* const data, std::size_t block, Fn_&& func) const {
+        if (length_ >= scan_block_size) {
+            auto row   = block / splits_;
+            auto first = block % splits_ * scan_block_size;
+            auto count = std::min(scan_block_size, length_ - first);
+            func(data + offset(row) + static_cast<std::ptrdiff_t>(first)
+                                          * stride_,
+                 count, row * length_ + first);
+        } else {
+            auto first = block * group_;
+            auto last  = std::min(first + group_, rows_);
+            for (auto row = first; row < last; ++row)
+                func(data + offset(row), length_, row * length_);
+        }
+    }
+
+    row_blocks(const shape_type& shape,
+               const shape_type& strides,
+               bool              reorder = true) {
+        auto nest = loop_nest(shape, std::span(&strides, 1), reorder);
+        shape_    = nest.shape();
+        strides_  = nest.strides(strides);
+        length_   = shape_.back();
+        stride_   = static_cast<std::ptrdiff_t>(strides_.back());
+        auto size = ranges::product(shape_);
+        if (size == 0)
+            return;
+        rows_   = size / length_;
+        splits_ = (length_ + scan_block_size - 1) / scan_block_size;
+        group_  = std::max<std::size_t>(scan_block_size / length_, 1);
+        size_   = length_ >= scan_block_size ? rows_ * splits_
+                                             : (rows_ + group_ - 1) / group_;
+    }
+
+ private:
+    shape_type     shape_;
+    shape_type     strides_;
+    std::size_t    length_ = 0; // Elements per row
+    std::ptrdiff_t stride_ = 0;
+    std::size_t    rows_   = 0;
+    std::size_t    splits_ = 1; // Blocks per row when rows are long
+    std::size_t    group_  = 1; // Rows per block when rows are short
+    std::size_t    size_   = 0;
+
+    auto offset(std::size_t row) const noexcept {
+        std::ptrdiff_t result = 0;
+        for (auto i = shape_.size() - 1; i-- > 0; row /= shape_[i])
+            result
+                += static_cast<std::ptrdiff_t>(row % shape_[i] * strides_[i]);
+        return result;
+    }
+};
+
+} // namespace detail
+
+} // namespace ax
+
+#endif /* NDARRAY_LAYOUT_H_DEFINED */
@@ -0,0 +1,504 @@
+#ifndef NDARRAY_LINALG_H_DEFINED
+#define NDARRAY_LINALG_H_DEFINED
+
+#include "../simd/batch.hpp"
+#include "core.hpp"
+#include "memory.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <utility>
+
+namespace ax {
+
+namespace detail {
+
+// Blocking of the matrix product. A micro-kernel keeps an mr x nr tile of
+// the output in registers, packed panels of kc columns of the left operand
+// (mc rows) are sized for the L2 cache and packed panels of kc rows of the
+// right operand (nc columns) for the L3 cache.
+template<class Tp_>
+struct gemm_blocking {
+    static constexpr std::size_t mr = 6;
+    static constexpr std::size_t nr = 2 * simd::batch<Tp_>::size;
+    static constexpr std::size_t kc = 256;
+    static constexpr std::size_t mc = 120;
+    static constexpr std::size_t nc = 8192 / sizeof(Tp_) / nr * nr;
+};
+
+// Computes the mr x nr tile c = a * b, or c += a * b with accumulate, from an
+// mr x kc panel of a packed column by column and a kc x nr panel of b packed
+// row by row. The tile is held in registers as mr rows of nr / size batches.
+template<class Tp_>
+inline void gemm_kernel(std::size_t      kc,
+                        const Tp_* const a,
+                        const Tp_* const b,
+                        Tp_* const       c,
+                        std::size_t      ldc,
+                        bool             accumulate) {
+    using batch      = simd::batch<Tp_>;
+    constexpr auto w = batch::size;
+    constexpr auto m = gemm_blocking<Tp_>::mr;
+    constexpr auto n = gemm_blocking<Tp_>::nr / w;
+
+    batch acc[m][n];
+    for (std::size_t i = 0; i < m; ++i)
+        for (std::size_t j = 0; j < n; ++j)
+            acc[i][j] = batch::broadcast(0);
+
+    for (std::size_t p = 0; p < kc; ++p) {
+        batch bv[n];
+        for (std::size_t j = 0; j < n; ++j)
+            bv[j] = batch::load_aligned(b + p * n * w + j * w);
+        for (std::size_t i = 0; i < m; ++i) {
+            auto av = batch::broadcast(a[p * m + i]);
+            for (std::size_t j = 0; j < n; ++j)
+                acc[i][j] = acc[i][j] + av * bv[j];
+        }
+    }
+
+    for (std::size_t i = 0; i < m; ++i)
+        for (std::size_t j = 0; j < n; ++j) {
+            auto ptr = c + i * ldc + j * w;
+            if (accumulate)
+                (batch::load(ptr) + acc[i][j]).store(ptr);
+            else
+                acc[i][j].store(ptr);
+        }
+}
+
+// Packs rows [0, mc) and columns [0, kc) of a into panels of mr rows, each
+// stored column by column and padded with zeros.
+template<class Tp_>
+inline void gemm_pack_a(Tp_* const       pack,
+                        const Tp_* const a,
+                        std::ptrdiff_t   rsa,
+                        std::ptrdiff_t   csa,
+                        std::size_t      mc,
+                        std::size_t      kc) {
+    constexpr auto mr = gemm_blocking<Tp_>::mr;
+    for (std::size_t ir = 0; ir < mc; ir += mr) {
+        auto panel = pack + ir * kc;
+        auto rows  = std::min(mr, mc - ir);
+        for (std::size_t p = 0; p < kc; ++p)
+            for (std::size_t i = 0; i < mr; ++i)
+                panel[p * mr + i]
+                    = i < rows ? a[static_cast<std::ptrdiff_t>(ir + i) * rsa
+                                   + static_cast<std::ptrdiff_t>(p) * csa]
+                               : Tp_ {};
+    }
+}
+
+// Packs panel jr / nr of rows [0, kc) and columns [0, nc) of b, stored row
+// by row and padded with zeros.
+template<class Tp_>
+inline void gemm_pack_b(Tp_* const       pack,
+                        const Tp_* const b,
+                        std::ptrdiff_t   rsb,
+                        std::ptrdiff_t   csb,
+                        std::size_t      jr,
+                        std::size_t      nc,
+                        std::size_t      kc) {
+    constexpr auto nr    = gemm_blocking<Tp_>::nr;
+    auto           panel = pack + jr * kc;
+    auto           cols  = std::min(nr, nc - jr);
+    for (std::size_t p = 0; p < kc; ++p)
+        for (std::size_t j = 0; j < nr; ++j)
+            panel[p * nr + j]
+                = j < cols ? b[static_cast<std::ptrdiff_t>(p) * rsb
+                               + static_cast<std::ptrdiff_t>(jr + j) * csb]
+                           : Tp_ {};
+}
+
+// Products with at most this many multiply-adds skip the packing of the
+// operands, whose cost is then larger than that of the product itself.
+constexpr std::size_t gemm_small_size = 32 * 32 * 32;
+
+// Calls func(std::integral_constant<std::size_t, I>()) for I in [0, N_), the
+// calls being spelled out in full rather than looped over.
+template<std::size_t N_, class Fn_>
+constexpr void unroll(Fn_&& func) {
+    [&]<std::size_t... Is_>(std::index_sequence<Is_...>) {
+        (func(std::integral_constant<std::size_t, Is_>()), ...);
+    }(std::make_index_sequence<N_>());
+}
+
+// Rows [i, i + R_) of a product of small matrices read in place. The rows
+// of c are accumulated from the rows of b scaled by the elements of a, each
+// load of b being shared by the R_ rows.
+template<std::size_t R_, class Tp_>
+inline void gemm_small_rows(std::size_t      i,
+                            std::size_t      n,
+                            std::size_t      k,
+                            const Tp_* const a,
+                            std::ptrdiff_t   rsa,
+                            std::ptrdiff_t   csa,
+                            const Tp_* const b,
+                            std::ptrdiff_t   rsb,
+                            std::ptrdiff_t   csb,
+                            Tp_* const       c,
+                            std::size_t      ldc) {
+    auto at = [](const Tp_* ptr, std::size_t row, std::ptrdiff_t rs,
+                 std::size_t col, std::ptrdiff_t cs) {
+        return ptr + static_cast<std::ptrdiff_t>(row) * rs
+             + static_cast<std::ptrdiff_t>(col) * cs;
+    };
+    auto j = std::size_t(0);
+    if constexpr (simd::vectorizable<Tp_>) {
+        using batch = simd::batch<Tp_>;
+        for (; j + batch::size <= n; j += batch::size) {
+            batch acc[R_];
+            unroll<R_>([&](auto r) { acc[r] = batch::broadcast(0); });
+            for (std::size_t p = 0; p < k; ++p) {
+                auto bv = batch::load_strided(at(b, p, rsb, j, csb), csb);
+                unroll<R_>([&](auto r) {
+                    acc[r] = acc[r]
+                           + batch::broadcast(*at(a, i + r, rsa, p, csa)) * bv;
+                });
+            }
+            unroll<R_>([&](auto r) { acc[r].store(c + (i + r) * ldc + j); });
+        }
+    }
+    for (; j < n; ++j)
+        for (std::size_t r = 0; r < R_; ++r) {
+            auto sum = Tp_ {};
+            for (std::size_t p = 0; p < k; ++p)
+                sum += *at(a, i + r, rsa, p, csa) * *at(b, p, rsb, j, csb);
+            c[(i + r) * ldc + j] = sum;
+        }
+}
+
+// Product of small matrices read in place, four rows at a time.
+template<class Tp_>
+inline void gemm_small(std::size_t      m,
+                       std::size_t      n,
+                       std::size_t      k,
+                       const Tp_* const a,
+                       std::ptrdiff_t   rsa,
+                       std::ptrdiff_t   csa,
+                       const Tp_* const b,
+                       std::ptrdiff_t   rsb,
+                       std::ptrdiff_t   csb,
+                       Tp_* const       c,
+                       std::size_t      ldc) {
+    auto i = std::size_t(0);
+    for (; i + 4 <= m; i += 4)
+        gemm_small_rows<4>(i, n, k, a, rsa, csa, b, rsb, csb, c, ldc);
+    for (; i < m; ++i)
+        gemm_small_rows<1>(i, n, k, a, rsa, csa, b, rsb, csb, c, ldc);
+}
+
+// Product of an m x N_ and an N_ x N_ matrix with the inner loops fully
+// unrolled. Rows of c of a multiple of the register width are held in
+// batches, shorter rows in scalars. Tall products are split by rows across
+// threads.
+template<std::size_t N_, class Tp_>
+inline void gemm_fixed(std::size_t      m,
+                       const Tp_* const a,
+                       std::ptrdiff_t   rsa,
+                       std::ptrdiff_t   csa,
+                       const Tp_* const b,
+                       std::ptrdiff_t   rsb,
+                       std::ptrdiff_t   csb,
+                       Tp_* const       c,
+                       std::size_t      ldc) {
+    constexpr auto width = [] {
+        if constexpr (simd::vectorizable<Tp_>)
+            return N_ % simd::batch<Tp_>::size == 0 ? simd::batch<Tp_>::size
+                                                    : 1;
+        return std::size_t(1);
+    }();
+    auto splat = [](Tp_ scalar) {
+        if constexpr (width == 1)
+            return scalar;
+        else
+            return simd::batch<Tp_>::broadcast(scalar);
+    };
+    auto load = [&](std::size_t p, std::size_t j) {
+        auto ptr = b + static_cast<std::ptrdiff_t>(p) * rsb
+                 + static_cast<std::ptrdiff_t>(j) * csb;
+        if constexpr (width == 1)
+            return *ptr;
+        else
+            return simd::batch<Tp_>::load_strided(ptr, csb);
+    };
+    using value = decltype(splat(Tp_ {}));
+
+    auto rows = [&](std::size_t first, std::size_t last) {
+        for (auto i = first; i < last; ++i) {
+            auto  arow = a + static_cast<std::ptrdiff_t>(i) * rsa;
+            value acc[N_ / width];
+            unroll<N_ / width>([&](auto j) { acc[j] = splat(0); });
+            unroll<N_>([&](auto p) {
+                auto av = splat(arow[static_cast<std::ptrdiff_t>(p()) * csa]);
+                unroll<N_ / width>([&](auto j) {
+                    acc[j] = acc[j] + av * load(p, j * width);
+                });
+            });
+            unroll<N_ / width>([&](auto j) {
+                if constexpr (width == 1)
+                    c[i * ldc + j] = acc[j];
+                else
+                    acc[j].store(c + i * ldc + j * width);
+            });
+        }
+    };
+    parallel_for(m, N_ * N_, rows);
+}
+
+// Computes the m x n product c = a * b of an m x k and a k x n matrix given
+// by their row and column strides, so transposed views are read in place.
+// The output is row-major with leading dimension ldc. Small products, square
+// ones of common sizes in particular, and types without SIMD support are
+// computed without packing.
+template<class Tp_>
+inline void gemm(std::size_t      m,
+                 std::size_t      n,
+                 std::size_t      k,
+                 const Tp_* const a,
+                 std::ptrdiff_t   rsa,
+                 std::ptrdiff_t   csa,
+                 const Tp_* const b,
+                 std::ptrdiff_t   rsb,
+                 std::ptrdiff_t   csb,
+                 Tp_* const       c,
+                 std::size_t      ldc) {
+    if (m == 0 || n == 0)
+        return;
+    auto span = trace::span("gemm", m * n, m * n * sizeof(Tp_));
+    span.path("fixed");
+    if (n == k) {
+        switch (n) {
+        case 2: return gemm_fixed<2>(m, a, rsa, csa, b, rsb, csb, c, ldc);
+        case 3: return gemm_fixed<3>(m, a, rsa, csa, b, rsb, csb, c, ldc);
+        case 4: return gemm_fixed<4>(m, a, rsa, csa, b, rsb, csb, c, ldc);
+        case 8: return gemm_fixed<8>(m, a, rsa, csa, b, rsb, csb, c, ldc);
+        case 16: return gemm_fixed<16>(m, a, rsa, csa, b, rsb, csb, c, ldc);
+        }
+    }
+    span.path("small");
+    if (m * n * k <= gemm_small_size || !simd::vectorizable<Tp_>)
+        return gemm_small(m, n, k, a, rsa, csa, b, rsb, csb, c, ldc);
+
+    span.path("packed");
+    if constexpr (simd::vectorizable<Tp_>) {
+        using blocking = gemm_blocking<Tp_>;
+        constexpr auto mr = blocking::mr;
+        constexpr auto nr = blocking::nr;
+
+        auto round = [](std::size_t x, std::size_t r) {
+            return (x + r - 1) / r * r;
+        };
+        auto bpack = allocate_buffer<Tp_>(
+            std::min(blocking::kc, k) * round(std::min(blocking::nc, n), nr));
+
+        for (std::size_t jc = 0; jc < n; jc += blocking::nc) {
+            auto nc      = std::min(blocking::nc, n - jc);
+            auto npanels = (nc + nr - 1) / nr;
+            for (std::size_t pc = 0; pc < k; pc += blocking::kc) {
+                auto kc     = std::min(blocking::kc, k - pc);
+                auto bblock = b + static_cast<std::ptrdiff_t>(pc) * rsb
+                            + static_cast<std::ptrdiff_t>(jc) * csb;
+                parallel_for(npanels, kc * nr, [&](auto first, auto last) {
+                    for (auto p = first; p < last; ++p)
+                        gemm_pack_b(bpack.get(), bblock, rsb, csb, p * nr, nc,
+                                    kc);
+                });
+
+                // Blocks of rows are further split into groups of panels
+                // of b when there are fewer of them than threads
+                auto nblocks = (m + blocking::mc - 1) / blocking::mc;
+                auto groups  = std::clamp<std::size_t>(
+                    get_num_threads() / nblocks, 1, npanels);
+                auto tasks = [&](std::size_t first, std::size_t last) {
+                    auto apack = allocate_buffer<Tp_>(blocking::mc * kc);
+                    auto block = nblocks;
+                    for (auto t = first; t < last; ++t) {
+                        auto ic = t / groups * blocking::mc;
+                        auto mc = std::min(blocking::mc, m - ic);
+                        if (t / groups != block) {
+                            block = t / groups;
+                            gemm_pack_a(
+                                apack.get(),
+                                a + static_cast<std::ptrdiff_t>(ic) * rsa
+                                    + static_cast<std::ptrdiff_t>(pc) * csa,
+                                rsa, csa, mc, kc);
+                        }
+                        auto group = t % groups;
+                        for (auto p = group * npanels / groups;
+                             p < (group + 1) * npanels / groups; ++p) {
+                            auto cols = std::min(nr, nc - p * nr);
+                            for (std::size_t ir = 0; ir < mc; ir += mr) {
+                                auto rows = std::min(mr, mc - ir);
+                                auto ap   = apack.get() + ir * kc;
+                                auto bp   = bpack.get() + p * nr * kc;
+                                auto cp   = c + (ic + ir) * ldc + jc + p * nr;
+                                if (rows == mr && cols == nr) {
+                                    gemm_kernel(kc, ap, bp, cp, ldc, pc != 0);
+                                    continue;
+                                }
+                                // Edge tiles go through a scratch tile
+                                alignas(64) Tp_ tile[mr * nr];
+                                gemm_kernel(kc, ap, bp, tile, nr, false);
+                                for (std::size_t i = 0; i < rows; ++i)
+                                    for (std::size_t j = 0; j < cols; ++j)
+                                        cp[i * ldc + j]
+                                            = pc != 0
+                                                ? cp[i * ldc + j]
+                                                      + tile[i * nr + j]
+                                                : tile[i * nr + j];
+                            }
+                        }
+                    }
+                };
+                parallel_for(nblocks * groups,
+                             blocking::mc * kc * nc / groups, tasks);
+            }
+        }
+    }
+}
+
+// Offset of batch index of a stack of matrices whose leading axes, given by
+// shape and strides, are broadcast against the batch shape.
+inline auto batch_offset(std::size_t                  index,
+                         std::span<const std::size_t> batch,
+                         std::span<const std::size_t> shape,
+                         std::span<const std::size_t> strides) {
+    std::ptrdiff_t result = 0;
+    auto           axis   = shape.size();
+    for (auto i = batch.size(); i-- > 0 && axis > 0; index /= batch[i]) {
+        --axis;
+        if (shape[axis] != 1)
+            result += static_cast<std::ptrdiff_t>(index % batch[i]
+                                                  * strides[axis]);
+    }
+    return result;
+}
+
+} // namespace detail
+
+// Matrix product following numpy.matmul. Arrays of rank above 2 are stacks
+// of matrices in their last two axes, the leading axes being broadcast
+// against each other. A vector on the left is a row and a vector on the
+// right is a column, the length one axis being dropped from the result.
+// Transposed views are multiplied without copying them, and the matrices of
+// a stack are spread across threads.
+template<class Tp_>
+inline auto matmul(const ndarray<Tp_>& lhs, const ndarray<Tp_>& rhs) {
+    ax_assert(lhs.rank() >= 1 && rhs.rank() >= 1,
+              "Cannot multiply arrays of rank 0!");
+    auto lshape   = std::span<const std::size_t>(lhs.shape());
+    auto rshape   = std::span<const std::size_t>(rhs.shape());
+    auto lstrides = std::span<const std::size_t>(lhs.strides());
+    auto rstrides = std::span<const std::size_t>(rhs.strides());
+    auto lmatrix  = lhs.rank() >= 2;
+    auto rmatrix  = rhs.rank() >= 2;
+    auto lrank    = lhs.rank() - (lmatrix ? 2 : 1);
+    auto rrank    = rhs.rank() - (rmatrix ? 2 : 1);
+
+    auto m = lmatrix ? lshape[lrank] : 1;
+    auto k = lshape.back();
+    auto n = rmatrix ? rshape.back() : 1;
+    ax_assert(k == rshape[rrank],
+              "Cannot multiply arrays of incompatible shape!");
+
+    auto lbatch = lshape.first(lrank);
+    auto rbatch = rshape.first(rrank);
+    auto batch  = detail::is_broadcastable_and_return_shape(lbatch, rbatch);
+    auto count  = ranges::product(batch);
+    auto shape  = batch;
+    if (lmatrix)
+        shape.push_back(m);
+    if (rmatrix)
+        shape.push_back(n);
+    auto result = ndarray<Tp_>(shape);
+
+    auto stride = [](std::span<const std::size_t> strides, std::size_t i) {
+        return static_cast<std::ptrdiff_t>(strides[i]);
+    };
+    auto rsa      = lmatrix ? stride(lstrides, lrank) : 0;
+    auto csa      = stride(lstrides, lstrides.size() - 1);
+    auto rsb      = stride(rstrides, rrank);
+    auto csb      = rmatrix ? stride(rstrides, rstrides.size() - 1) : 0;
+    auto multiply = [&](std::size_t first, std::size_t last) {
+        for (auto i = first; i < last; ++i)
+            detail::gemm(
+                m, n, k,
+                lhs.data()
+                    + detail::batch_offset(i, batch, lbatch,
+                                           lstrides.first(lrank)),
+                rsa, csa,
+                rhs.data()
+                    + detail::batch_offset(i, batch, rbatch,
+                                           rstrides.first(rrank)),
+                rsb, csb, result.data() + i * m * n, n);
+    };
+
+    // Stacks of fewer matrices than threads leave each product to use them
+    if (count < get_num_threads())
+        multiply(0, count);
+    else
+        detail::parallel_for(count, m * n * k, multiply);
+    return result;
+}
+
+// Dot product following numpy.dot, a sum over the last axis of lhs and the
+// second to last axis of rhs, or its only axis for a vector. The result has
+// the remaining axes of lhs followed by those of rhs. Unless both arrays
+// are of rank 2 or more and one of them above 2 this is matmul, otherwise
+// each matrix of rhs is multiplied by all rows of lhs at once.
+template<class Tp_>
+inline auto dot(const ndarray<Tp_>& lhs, const ndarray<Tp_>& rhs) {
+    if (lhs.rank() <= 1 || rhs.rank() <= 1
+        || (lhs.rank() == 2 && rhs.rank() == 2))
+        return matmul(lhs, rhs);
+
+    auto& lshape   = lhs.shape();
+    auto& rshape   = rhs.shape();
+    auto  rstrides = std::span<const std::size_t>(rhs.strides());
+    auto  rrank    = rhs.rank() - 2;
+    auto  k        = lshape.back();
+    ax_assert(k == rshape[rrank],
+              "Cannot multiply arrays of incompatible shape!");
+    ax_assert(lhs.rank() + rhs.rank() - 2 <= max_rank,
+              "Cannot multiply into more axes than the maximum rank!");
+
+    auto shape = shape_type(lshape.begin(), lshape.end() - 1);
+    for (std::size_t i = 0; i < rrank; ++i)
+        shape.push_back(rshape[i]);
+    shape.push_back(rshape.back());
+    auto result = ndarray<Tp_>(shape);
+
+    // The rows of lhs form one matrix, each product fills a column block
+    std::size_t m = 1;
+    for (std::size_t i = 0; i + 1 < lhs.rank(); ++i)
+        m *= lshape[i];
+    const auto a      = lhs.as_layout(stride_type::row_major);
+    auto       rbatch = std::span<const std::size_t>(rshape).first(rrank);
+    auto       n      = rshape.back();
+    auto       count  = ranges::product(rbatch);
+    auto       rsb    = static_cast<std::ptrdiff_t>(rstrides[rrank]);
+    auto       csb    = static_cast<std::ptrdiff_t>(rstrides[rrank + 1]);
+
+    auto multiply = [&](std::size_t first, std::size_t last) {
+        for (auto i = first; i < last; ++i)
+            detail::gemm(m, n, k, a.data(), static_cast<std::ptrdiff_t>(k), 1,
+                         rhs.data()
+                             + detail::batch_offset(i, rbatch, rbatch,
+                                                    rstrides.first(rrank)),
+                         rsb, csb, result.data() + i * n, count * n);
+    };
+
+    if (count < get_num_threads())
+        multiply(0, count);
+    else
+        detail::parallel_for(count, m * n * k, multiply);
+    return result;
+}
+
+} // namespace ax
+
+#endif /* NDARRAY_LINALG_H_DEFINED */
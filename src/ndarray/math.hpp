@@ -1,68 +1,112 @@
 #ifndef MATH_H_DEFINED
 #define MATH_H_DEFINED
 
+#include "../simd/math.hpp"
 #include "core.hpp"
+#include "extrema.hpp"
+#include "reduce.hpp"
+#include "summation.hpp"
 
 #include <cmath>
-#include <functional>
+#include <type_traits>
 
 namespace ax {
 
+// The extremes of an array are NaN when it holds a NaN, unless the policy
+// omits them. An array of nothing but NaN always gives NaN.
 template<class Tp_>
-constexpr auto max(const ndarray<Tp_>& array) {
+constexpr auto max(const ndarray<Tp_>& array,
+                   nan_policy          policy = nan_policy::propagate) {
     ax_assert(array.size() > 0, "Cannot find max of array of size 0!");
-    auto ptr = array.data();
-    auto max = *ptr;
-    for (std::size_t i = 1; i < array.size(); ++i) {
-        auto value = ptr[i];
-        if (value > max)
-            max = ptr[i];
-    }
-    return max;
+    auto state = detail::extrema<false, true>(array.data(), array.shape(),
+                                              array.strides());
+    return detail::apply_nan_policy(state.max, state.nans, array.size(),
+                                    policy);
 }
 
 template<class Tp_>
-constexpr auto min(const ndarray<Tp_>& array) {
-    ax_assert(array.size() > 0, "Cannot find max of array of size 0!");
-    auto ptr = array.data();
-    auto min = *ptr;
-    for (std::size_t i = 1; i < array.size(); ++i) {
-        auto value = ptr[i];
-        if (value < min)
-            min = value;
-    }
-    return min;
+constexpr auto min(const ndarray<Tp_>& array,
+                   nan_policy          policy = nan_policy::propagate) {
+    ax_assert(array.size() > 0, "Cannot find min of array of size 0!");
+    auto state = detail::extrema<true, false>(array.data(), array.shape(),
+                                              array.strides());
+    return detail::apply_nan_policy(state.min, state.nans, array.size(),
+                                    policy);
 }
 
 template<class Tp_>
-constexpr auto minmax(const ndarray<Tp_>& array) {
-    ax_assert(array.size() > 0, "Cannot find max of array of size 0!");
-    auto ptr = array.data();
-    auto min = *ptr;
-    auto max = *ptr;
-    for (std::size_t i = 1; i < array.size(); ++i) {
-        auto value = ptr[i];
-        if (value < min)
-            min = value;
-        else if (value > max)
-            max = value;
-    }
-    return std::make_pair(min, max);
+constexpr auto minmax(const ndarray<Tp_>& array,
+                      nan_policy          policy = nan_policy::propagate) {
+    ax_assert(array.size() > 0, "Cannot find minmax of array of size 0!");
+    auto state = detail::extrema<true, true>(array.data(), array.shape(),
+                                             array.strides());
+    return std::make_pair(
+        detail::apply_nan_policy(state.min, state.nans, array.size(), policy),
+        detail::apply_nan_policy(state.max, state.nans, array.size(), policy));
+}
+
+// Row-major index of the first minimum or maximum, or of the first NaN when
+// propagating.
+template<class Tp_>
+constexpr auto argmin(const ndarray<Tp_>& array,
+                      nan_policy          policy = nan_policy::propagate) {
+    ax_assert(array.size() > 0, "Cannot find argmin of array of size 0!");
+    auto index = detail::arg_extremum<false>(array.data(), array.shape(),
+                                             array.strides(), policy);
+    ax_assert(index != detail::no_index, "Cannot find argmin of only NaN!");
+    return index;
+}
+
+template<class Tp_>
+constexpr auto argmax(const ndarray<Tp_>& array,
+                      nan_policy          policy = nan_policy::propagate) {
+    ax_assert(array.size() > 0, "Cannot find argmax of array of size 0!");
+    auto index = detail::arg_extremum<true>(array.data(), array.shape(),
+                                            array.strides(), policy);
+    ax_assert(index != detail::no_index, "Cannot find argmax of only NaN!");
+    return index;
 }
 
 template<class Tp_>
 constexpr auto sin(const ndarray<Tp_>& array) {
-    return array.apply(static_cast<double (*)(Tp_)>(std::sin));
+    return array.apply(simd::vectorize(
+        [](const auto& x) { return simd::sin(x); }));
 }
 
 template<class Tp_>
 constexpr auto cos(const ndarray<Tp_>& array) {
-    return array.apply(static_cast<double (*)(Tp_)>(std::cos));
+    return array.apply(simd::vectorize(
+        [](const auto& x) { return simd::cos(x); }));
 }
 
 template<class Tp_>
 constexpr auto tan(const ndarray<Tp_>& array) {
-    return array.apply(static_cast<double (*)(Tp_)>(std::tan));
+    return array.apply(simd::vectorize(
+        [](const auto& x) { return simd::tan(x); }));
+}
+
+template<class Tp_>
+constexpr auto exp(const ndarray<Tp_>& array) {
+    return array.apply(simd::vectorize(
+        [](const auto& x) { return simd::exp(x); }));
+}
+
+template<class Tp_>
+constexpr auto log(const ndarray<Tp_>& array) {
+    return array.apply(simd::vectorize(
+        [](const auto& x) { return simd::log(x); }));
+}
+
+template<class Tp_>
+constexpr auto tanh(const ndarray<Tp_>& array) {
+    return array.apply(simd::vectorize(
+        [](const auto& x) { return simd::tanh(x); }));
+}
+
+template<class Tp_>
+constexpr auto sigmoid(const ndarray<Tp_>& array) {
+    return array.apply(simd::vectorize(
+        [](const auto& x) { return simd::sigmoid(x); }));
 }
 
 template<class Tp_>
@@ -70,64 +114,135 @@ constexpr auto abs(const ndarray<Tp_>& array) {
     return array.apply(static_cast<Tp_ (*)(Tp_)>(std::abs));
 }
 
+// Floating point arrays are raised in their own precision, with the
+// exponent converted to it.
 template<class Tp_, class Ex_>
 constexpr auto pow(const ndarray<Tp_>& array, Ex_ exp) {
-    return array.apply(
-        std::bind(std::pow<Tp_, Ex_>, std::placeholders::_1, exp));
+    if constexpr (std::is_floating_point_v<Tp_>)
+        return array.apply(simd::vectorize(
+            [exp = static_cast<Tp_>(exp)](const auto& x) {
+                return simd::pow(x, exp);
+            }));
+    else
+        return array.apply([exp](Tp_ x) { return std::pow(x, exp); });
 }
 
-template<class Tp_,
-         class Rt_
-         = std::conditional_t<std::is_floating_point_v<Tp_>, Tp_, double>>
+template<class Tp_>
 constexpr auto sqrt(const ndarray<Tp_>& array) {
-    return array.apply(static_cast<Rt_ (*)(Tp_)>(std::sqrt));
+    return array.apply(simd::vectorize(
+        [](const auto& x) { return simd::sqrt(x); }));
 }
 
 template<class Tp_>
 constexpr auto floor(const ndarray<Tp_>& array) {
-    return array.apply(static_cast<double (*)(Tp_)>(std::floor));
+    return array.apply([](Tp_ x) { return std::floor(x); });
 }
 
 template<class Tp_>
 constexpr auto ceil(const ndarray<Tp_>& array) {
-    return array.apply(static_cast<double (*)(Tp_)>(std::ceil));
+    return array.apply([](Tp_ x) { return std::ceil(x); });
 }
 
 template<class Tp_>
 constexpr auto rint(const ndarray<Tp_>& array) {
-    return array.apply(static_cast<double (*)(Tp_)>(std::rint));
+    return array.apply([](Tp_ x) { return std::rint(x); });
 }
 
 template<class Tp_>
-constexpr auto sum(const ndarray<Tp_>& array) {
-    Tp_  result = Tp_ {};
-    auto data   = array.data();
-    for (std::size_t i = 0; i < array.size(); ++i)
-        result += data[i];
-    return result;
+constexpr auto sum(const ndarray<Tp_>& array,
+                   summation           mode = summation::pairwise) {
+    return detail::sum_all(array.data(), array.shape(), array.strides(), mode);
 }
 
 template<class Tp_>
-constexpr auto sum(const ndarray<Tp_>& array, std::size_t axis) {
-    // TODO: OPTIMIZE THIS? BENCHMARK FIRST
-    const auto& old_shape = array.shape();
-    auto        new_shape = std::vector<std::size_t>(array.rank() - 1);
-    for (auto&& [i, x] : std::views::zip(std::views::iota(0ul, array.rank())
-                                             | std::views::drop(axis),
-                                         new_shape)) {
-        x = old_shape[i];
-    }
+constexpr auto prod(const ndarray<Tp_>& array) {
+    return detail::reduce_all(array, detail::prod_reducer<Tp_>());
+}
 
-    auto new_array = ndarray<Tp_>(new_shape);
-    auto range     = std::views::iota(0ul, array.rank());
-    auto axes      = std::vector(range.begin(), range.end());
-    std::swap(axes[axis], axes[0]);
-    auto array_view = array.transpose(axes);
+template<class Tp_>
+constexpr auto mean(const ndarray<Tp_>& array) {
+    if constexpr (std::is_floating_point_v<Tp_>)
+        return sum(array) / static_cast<Tp_>(array.size());
+    else
+        return detail::reduce_all(array, detail::mean_reducer<Tp_>());
+}
 
-    for (auto i : std::views::iota(0ul, old_shape[axis]))
-        new_array += array_view.view(i);
+template<class Tp_>
+constexpr auto var(const ndarray<Tp_>& array) {
+    return detail::reduce_all(array, detail::var_reducer<Tp_>());
+}
+
+// Reductions along axes are computed in a single pass over the array. With
+// keepdims the reduced axes are kept with length one so that the result
+// broadcasts against the input.
+template<class Tp_>
+constexpr auto
+sum(const ndarray<Tp_>& array, const axis_set& axes, bool keepdims = false) {
+    return detail::reduce(array, axes, keepdims, detail::sum_reducer<Tp_>());
+}
+
+template<class Tp_>
+constexpr auto
+prod(const ndarray<Tp_>& array, const axis_set& axes, bool keepdims = false) {
+    return detail::reduce(array, axes, keepdims, detail::prod_reducer<Tp_>());
+}
+
+template<class Tp_>
+constexpr auto
+mean(const ndarray<Tp_>& array, const axis_set& axes, bool keepdims = false) {
+    return detail::reduce(array, axes, keepdims, detail::mean_reducer<Tp_>());
+}
+
+// Variance with ddof delta degrees of freedom, i.e. divided by n - ddof.
+template<class Tp_>
+constexpr auto var(const ndarray<Tp_>& array,
+                   const axis_set&     axes,
+                   bool                keepdims = false,
+                   std::size_t         ddof     = 0) {
+    return detail::reduce(array, axes, keepdims,
+                          detail::var_reducer<Tp_> {ddof});
+}
+
+template<class Tp_>
+constexpr auto min(const ndarray<Tp_>& array,
+                   const axis_set&     axes,
+                   bool                keepdims = false,
+                   nan_policy          policy   = nan_policy::propagate) {
+    ax_assert(array.size() > 0, "Cannot find min of array of size 0!");
+    return detail::reduce(array, axes, keepdims,
+                          detail::min_reducer<Tp_> {policy});
+}
+
+template<class Tp_>
+constexpr auto max(const ndarray<Tp_>& array,
+                   const axis_set&     axes,
+                   bool                keepdims = false,
+                   nan_policy          policy   = nan_policy::propagate) {
+    ax_assert(array.size() > 0, "Cannot find max of array of size 0!");
+    return detail::reduce(array, axes, keepdims,
+                          detail::max_reducer<Tp_> {policy});
+}
+
+// Positions are row-major over the reduced axes, for a single axis this is
+// the index along that axis.
+template<class Tp_>
+constexpr auto argmin(const ndarray<Tp_>& array,
+                      const axis_set&     axes,
+                      bool                keepdims = false,
+                      nan_policy          policy   = nan_policy::propagate) {
+    ax_assert(array.size() > 0, "Cannot find argmin of array of size 0!");
+    return detail::reduce(array, axes, keepdims,
+                          detail::argmin_reducer<Tp_> {policy});
+}
 
-    return new_array;
+template<class Tp_>
+constexpr auto argmax(const ndarray<Tp_>& array,
+                      const axis_set&     axes,
+                      bool                keepdims = false,
+                      nan_policy          policy   = nan_policy::propagate) {
+    ax_assert(array.size() > 0, "Cannot find argmax of array of size 0!");
+    return detail::reduce(array, axes, keepdims,
+                          detail::argmax_reducer<Tp_> {policy});
 }
 
 } // namespace ax
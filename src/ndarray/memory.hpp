@@ -0,0 +1,197 @@
+#ifndef NDARRAY_MEMORY_H_DEFINED
+#define NDARRAY_MEMORY_H_DEFINED
+
+#include "../core.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+namespace ax {
+
+struct pool_statistics {
+    std::size_t hits         = 0; // Allocations served from the pool
+    std::size_t misses       = 0; // Allocations that went to the upstream
+    std::size_t recycled     = 0; // Deallocations kept for reuse
+    std::size_t released     = 0; // Deallocations returned to the upstream
+    std::size_t cached_bytes = 0; // Bytes currently held by the pool
+};
+
+// Memory resource handing out 64-byte aligned blocks grouped into size
+// classes. Freed blocks are kept per class and handed back out to the next
+// allocation of the same class, so the storm of equally sized temporaries
+// produced by broadcasting is served without touching the system allocator.
+// Size classes are spaced four per power of two which bounds the wasted
+// space to a quarter of each block.
+class pool_resource : public std::pmr::memory_resource {
+ public:
+    static constexpr std::size_t alignment  = 64;
+    static constexpr std::size_t min_block  = 64;
+    static constexpr std::size_t max_cached = std::size_t(1) << 30;
+
+    static constexpr auto block_size(std::size_t bytes) noexcept {
+        if (bytes <= min_block)
+            return min_block;
+        auto step = std::size_t(1) << (std::bit_width(bytes - 1) - 3);
+        return (bytes + step - 1) & ~(step - 1);
+    }
+
+    auto statistics() const {
+        auto lock = std::scoped_lock(mutex_);
+        return stats_;
+    }
+
+    void reset_statistics() {
+        auto lock   = std::scoped_lock(mutex_);
+        auto cached = stats_.cached_bytes;
+        stats_      = pool_statistics {};
+        stats_.cached_bytes = cached;
+    }
+
+    // Returns every cached block to the upstream allocator.
+    void release() {
+        auto lock = std::scoped_lock(mutex_);
+        for (auto& [size, blocks] : free_)
+            for (auto ptr : blocks)
+                ::operator delete(ptr, size, std::align_val_t(alignment));
+        free_.clear();
+        stats_.cached_bytes = 0;
+    }
+
+    explicit pool_resource(std::size_t max_cached_bytes = max_cached)
+        : max_cached_bytes_(max_cached_bytes) {
+    }
+
+    pool_resource(const pool_resource&) = delete;
+
+    pool_resource& operator=(const pool_resource&) = delete;
+
+    ~pool_resource() override {
+        release();
+    }
+
+ private:
+    mutable std::mutex                                  mutex_;
+    std::unordered_map<std::size_t, std::vector<void*>> free_;
+    pool_statistics                                     stats_;
+    std::size_t                                         max_cached_bytes_;
+
+    void* do_allocate(std::size_t bytes, std::size_t align) override {
+        // Over-aligned requests bypass the pool
+        if (align > alignment)
+            return ::operator new(bytes, std::align_val_t(align));
+        auto size = block_size(bytes);
+        {
+            auto lock = std::scoped_lock(mutex_);
+            auto it   = free_.find(size);
+            if (it != free_.end() && !it->second.empty()) {
+                auto ptr = it->second.back();
+                it->second.pop_back();
+                stats_.hits++;
+                stats_.cached_bytes -= size;
+                return ptr;
+            }
+            stats_.misses++;
+        }
+        return ::operator new(size, std::align_val_t(alignment));
+    }
+
+    void
+    do_deallocate(void* ptr, std::size_t bytes, std::size_t align) override {
+        if (align > alignment) {
+            ::operator delete(ptr, bytes, std::align_val_t(align));
+            return;
+        }
+        auto size = block_size(bytes);
+        {
+            auto lock = std::scoped_lock(mutex_);
+            if (stats_.cached_bytes + size <= max_cached_bytes_) {
+                free_[size].push_back(ptr);
+                stats_.recycled++;
+                stats_.cached_bytes += size;
+                return;
+            }
+            stats_.released++;
+        }
+        ::operator delete(ptr, size, std::align_val_t(alignment));
+    }
+
+    bool do_is_equal(
+        const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+namespace detail {
+
+inline auto& default_resource_ptr() {
+    // Intentionally leaked so that arrays with static storage duration can
+    // still return their buffers during shutdown.
+    static std::atomic<std::pmr::memory_resource*> resource
+        = new pool_resource();
+    return resource;
+}
+
+} // namespace detail
+
+// The resource new ndarray buffers are allocated from.
+inline std::pmr::memory_resource* get_default_resource() noexcept {
+    return detail::default_resource_ptr().load(std::memory_order_relaxed);
+}
+
+// Replaces the resource used for new ndarray buffers and returns the previous
+// one. Buffers already allocated are always returned to the resource they
+// came from. Passing std::pmr::new_delete_resource() disables pooling.
+inline std::pmr::memory_resource*
+set_default_resource(std::pmr::memory_resource* resource) noexcept {
+    return detail::default_resource_ptr().exchange(resource);
+}
+
+// Statistics of the built-in pool, empty if the default has been replaced by
+// a resource of a different type.
+inline auto default_pool_statistics() {
+    auto pool = dynamic_cast<pool_resource*>(get_default_resource());
+    return pool ? pool->statistics() : pool_statistics {};
+}
+
+namespace detail {
+
+template<class Tp_>
+struct buffer_deleter {
+    std::pmr::memory_resource* resource;
+    std::size_t                size;
+
+    void operator()(Tp_* ptr) const {
+        std::destroy_n(ptr, size);
+        resource->deallocate(ptr, size * sizeof(Tp_),
+                             std::max(alignof(Tp_), pool_resource::alignment));
+    }
+};
+
+// Allocates storage for an ndarray of the given size. Elements are default
+// initialized like new Tp_[size] and the shared_ptr control block is taken
+// from the same resource so that no call reaches the system allocator once
+// the pool is warm.
+template<class Tp_>
+inline auto allocate_buffer(std::size_t                size,
+                            std::pmr::memory_resource* resource
+                            = get_default_resource()) {
+    auto align = std::max(alignof(Tp_), pool_resource::alignment);
+    auto ptr = static_cast<Tp_*>(resource->allocate(size * sizeof(Tp_), align));
+    std::uninitialized_default_construct_n(ptr, size);
+    return std::shared_ptr<Tp_[]>(ptr, buffer_deleter<Tp_> {resource, size},
+                                  std::pmr::polymorphic_allocator(resource));
+}
+
+} // namespace detail
+
+} // namespace ax
+
+#endif /* NDARRAY_MEMORY_H_DEFINED */
@@ -0,0 +1,279 @@
+#ifndef NDARRAY_NPY_H_DEFINED
+#define NDARRAY_NPY_H_DEFINED
+
+#include "../core.hpp"
+#include "core.hpp"
+#include "extents.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace ax {
+
+// How load_npy gets at the data of a file. Without mmap support the file is
+// always read.
+enum class npy_mode : int {
+    read,      // Read into a newly allocated buffer
+    map,       // Map the file, writes go to private copies of its pages
+    map_shared // Map the file, writes go to the file itself
+};
+
+namespace detail {
+
+// Problems with the file itself are reported whether or not assertions are
+// compiled in, as they depend on the input rather than on the caller.
+inline void npy_check(bool condition, const char* message) {
+    if (!condition)
+        throw std::runtime_error(message);
+}
+
+// Type string of Tp_ in the header of an npy file, e.g. '<f8' for a double
+// on a little endian machine.
+template<class Tp_>
+inline auto npy_descr() {
+    static_assert(std::is_arithmetic_v<Tp_>,
+                  "Only arithmetic types can be stored in npy files!");
+    char order = std::endian::native == std::endian::little ? '<' : '>';
+    char kind  = std::is_floating_point_v<Tp_> ? 'f'
+               : std::is_signed_v<Tp_>         ? 'i'
+                                               : 'u';
+    if (sizeof(Tp_) == 1)
+        order = '|';
+    if (std::is_same_v<Tp_, bool>)
+        kind = 'b';
+    return std::string {order, kind} + std::to_string(sizeof(Tp_));
+}
+
+struct npy_header {
+    std::string descr;
+    bool        fortran_order = false;
+    shape_type  shape;
+    std::size_t offset = 0; // Of the data from the start of the file
+};
+
+// Text of the value of key in the header, which is a Python dictionary
+// literal such as {'descr': '<f8', 'fortran_order': False, 'shape': (3,), }.
+inline auto npy_value(std::string_view dict, std::string_view key) {
+    auto pos = dict.find("'" + std::string(key) + "'");
+    npy_check(pos != dict.npos, "Missing key in npy header!");
+    pos = dict.find_first_not_of(" :", pos + key.size() + 2);
+    npy_check(pos != dict.npos, "Malformed npy header!");
+    auto last = dict[pos] == '(' ? dict.find(')', pos) + 1
+              : dict[pos] == '\'' ? dict.find('\'', pos + 1) + 1
+                                  : dict.find_first_of(",}", pos);
+    npy_check(last != dict.npos && last > pos, "Malformed npy header!");
+    return dict.substr(pos, last - pos);
+}
+
+inline auto read_npy_header(std::istream& in) {
+    auto read_le = [&](std::size_t bytes) {
+        unsigned char buffer[4] = {};
+        in.read(reinterpret_cast<char*>(buffer),
+                static_cast<std::streamsize>(bytes));
+        std::size_t value = 0;
+        for (std::size_t i = bytes; i-- > 0;)
+            value = value << 8 | buffer[i];
+        return value;
+    };
+
+    char magic[6] = {};
+    in.read(magic, 6);
+    npy_check(in && std::string_view(magic, 6) == "\x93NUMPY",
+              "File is not in npy format!");
+    auto major = read_le(1);
+    read_le(1);
+    npy_check(major >= 1 && major <= 3, "Unsupported npy format version!");
+    auto length = read_le(major == 1 ? 2 : 4);
+    auto dict   = std::string(length, '\0');
+    in.read(dict.data(), static_cast<std::streamsize>(length));
+    npy_check(bool(in), "Truncated npy header!");
+
+    auto header   = npy_header();
+    auto descr    = npy_value(dict, "descr");
+    npy_check(descr.size() >= 2 && descr.front() == '\'',
+              "Malformed npy header!");
+    header.descr  = descr.substr(1, descr.size() - 2);
+    header.offset = (major == 1 ? 10 : 12) + length;
+
+    auto order = npy_value(dict, "fortran_order");
+    npy_check(order == "True" || order == "False", "Malformed npy header!");
+    header.fortran_order = order == "True";
+
+    // Dimensions are separated by commas, with a trailing one for rank 1
+    auto dims = npy_value(dict, "shape");
+    npy_check(dims.front() == '(', "Malformed npy header!");
+    for (std::size_t pos = 1; pos + 1 < dims.size();) {
+        pos = dims.find_first_not_of(", ", pos);
+        if (pos == dims.npos || dims[pos] == ')')
+            break;
+        std::size_t extent = 0;
+        for (; dims[pos] >= '0' && dims[pos] <= '9'; ++pos)
+            extent = extent * 10 + static_cast<std::size_t>(dims[pos] - '0');
+        npy_check(dims[pos] == ',' || dims[pos] == ')' || dims[pos] == ' ',
+                  "Malformed npy header!");
+        header.shape.push_back(extent);
+    }
+    return header;
+}
+
+// Checks that the data of an npy file is of type Tp_ and tells whether it
+// is in foreign byte order.
+template<class Tp_>
+inline auto npy_byteswapped(const npy_header& header) {
+    auto descr = npy_descr<Tp_>();
+    npy_check(header.descr.substr(1) == descr.substr(1),
+              "Data type of npy file does not match the array!");
+    return descr[0] != '|' && header.descr[0] != descr[0]
+        && header.descr[0] != '=';
+}
+
+// Writes the header of an npy file and returns its length. The header is
+// padded with spaces so that the data starts on a 64 byte boundary, which
+// keeps mapped data aligned.
+inline auto write_npy_header(std::ostream&     out,
+                             const std::string& descr,
+                             bool               fortran_order,
+                             const shape_type&  shape) {
+    auto dims = std::string();
+    for (auto extent : shape)
+        dims += std::to_string(extent) + ", ";
+    if (shape.size() >= 2)
+        dims.resize(dims.size() - 2);
+    else if (shape.size() == 1)
+        dims.pop_back();
+
+    auto dict = "{'descr': '" + descr + "', 'fortran_order': "
+              + (fortran_order ? "True" : "False") + ", 'shape': (" + dims
+              + "), }";
+
+    auto major   = dict.size() + 64 <= 65535 ? 1 : 2;
+    auto prefix  = std::size_t(major == 1 ? 10 : 12);
+    auto padding = (64 - (prefix + dict.size() + 1) % 64) % 64;
+    dict += std::string(padding, ' ') + '\n';
+
+    out.write("\x93NUMPY", 6);
+    out.put(static_cast<char>(major));
+    out.put(0);
+    for (std::size_t i = 0; i < prefix - 8; ++i)
+        out.put(static_cast<char>(dict.size() >> (8 * i) & 0xff));
+    out.write(dict.data(), static_cast<std::streamsize>(dict.size()));
+    return prefix + dict.size();
+}
+
+// Extents of the data of an npy file, column-major for Fortran order.
+inline auto npy_extents(const npy_header& header) {
+    return ndarray_extents<>(header.shape, header.fortran_order
+                                               ? stride_type::column_major
+                                               : stride_type::row_major);
+}
+
+template<class Tp_>
+inline void byteswap(Tp_* const data, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        auto bytes = reinterpret_cast<unsigned char*>(data + i);
+        std::reverse(bytes, bytes + sizeof(Tp_));
+    }
+}
+
+// Maps the data of an npy file, the mapping lives as long as the buffer.
+template<class Tp_>
+inline auto map_npy(const std::filesystem::path& path,
+                    const npy_header&            header,
+                    std::size_t                  size,
+                    bool                         shared) {
+#if __has_include(<sys/mman.h>)
+    npy_check(header.offset % alignof(Tp_) == 0,
+              "Cannot map npy data that is not aligned!");
+    auto length = header.offset + size * sizeof(Tp_);
+    npy_check(std::filesystem::file_size(path) >= length,
+              "Truncated npy data!");
+    auto fd = ::open(path.c_str(), shared ? O_RDWR : O_RDONLY);
+    npy_check(fd >= 0, "Cannot open npy file!");
+    auto base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                       shared ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    npy_check(base != MAP_FAILED, "Cannot map npy file!");
+    auto data = reinterpret_cast<Tp_*>(static_cast<char*>(base)
+                                       + header.offset);
+    return std::shared_ptr<Tp_[]>(data, [base, length](Tp_*) {
+        ::munmap(base, length);
+    });
+#else
+    return std::shared_ptr<Tp_[]>();
+#endif
+}
+
+} // namespace detail
+
+// Loads an array from a file in numpy's npy format, whose data type has to
+// be Tp_. Arrays in Fortran order come back as column-major arrays. When
+// mapped the data is paged in on demand, which requires it to be in native
+// byte order. Files that cannot be read, are malformed or hold another data
+// type throw std::runtime_error.
+template<class Tp_>
+inline auto load_npy(const std::filesystem::path& path,
+                     npy_mode                     mode = npy_mode::read) {
+    auto in = std::ifstream(path, std::ios::binary);
+    detail::npy_check(bool(in), "Cannot open npy file!");
+    auto header = detail::read_npy_header(in);
+    auto swap   = detail::npy_byteswapped<Tp_>(header);
+
+    auto extents = detail::npy_extents(header);
+    auto size    = extents.size();
+    if (mode != npy_mode::read && size != 0) {
+        detail::npy_check(!swap,
+                          "Cannot map npy data of foreign byte order!");
+        auto data = detail::map_npy<Tp_>(path, header, size,
+                                         mode == npy_mode::map_shared);
+        if (data)
+            return ndarray<Tp_>(data, extents);
+    }
+
+    auto array = ndarray<Tp_>(extents);
+    in.read(reinterpret_cast<char*>(array.data()),
+            static_cast<std::streamsize>(size * sizeof(Tp_)));
+    detail::npy_check(in || size == 0, "Truncated npy data!");
+    if (swap)
+        detail::byteswap(array.data(), size);
+    return array;
+}
+
+// Saves an array in numpy's npy format. Row-major and column-major arrays
+// are written as they are, others through a row-major copy. Failed writes
+// throw std::runtime_error.
+template<class Tp_>
+inline void save_npy(const std::filesystem::path& path,
+                     const ndarray<Tp_>&          array) {
+    auto row_major = array.is_contiguous(stride_type::row_major);
+    auto fortran   = !row_major
+                && array.is_contiguous(stride_type::column_major);
+    if (!row_major && !fortran)
+        return save_npy(path, array.as_layout(stride_type::row_major));
+
+    auto out = std::ofstream(path, std::ios::binary);
+    detail::npy_check(bool(out), "Cannot open npy file!");
+    detail::write_npy_header(out, detail::npy_descr<Tp_>(), fortran,
+                             array.shape());
+    out.write(reinterpret_cast<const char*>(array.data()),
+              static_cast<std::streamsize>(array.size() * sizeof(Tp_)));
+    detail::npy_check(bool(out), "Cannot write npy file!");
+}
+
+} // namespace ax
+
+#endif /* NDARRAY_NPY_H_DEFINED */
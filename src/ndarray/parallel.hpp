@@ -0,0 +1,102 @@
+#ifndef NDARRAY_PARALLEL_H_DEFINED
+#define NDARRAY_PARALLEL_H_DEFINED
+
+#include "../core.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace ax {
+
+namespace detail {
+
+inline auto& num_threads_setting() {
+    static std::atomic<std::size_t> num_threads = 0;
+    return num_threads;
+}
+
+inline auto& parallel_threshold_setting() {
+    static std::atomic<std::size_t> threshold = std::size_t(1) << 16;
+    return threshold;
+}
+
+} // namespace detail
+
+// Number of threads used by element-wise operations. Defaults to the OpenMP
+// maximum (OMP_NUM_THREADS) and is always one in builds without OpenMP.
+inline std::size_t get_num_threads() noexcept {
+#if defined(_OPENMP)
+    auto num_threads
+        = detail::num_threads_setting().load(std::memory_order_relaxed);
+    return num_threads ? num_threads
+                       : static_cast<std::size_t>(omp_get_max_threads());
+#else
+    return 1;
+#endif
+}
+
+// Sets the number of threads used by element-wise operations, zero restores
+// the OpenMP default.
+inline void set_num_threads(std::size_t num_threads) noexcept {
+    detail::num_threads_setting().store(num_threads, std::memory_order_relaxed);
+}
+
+// Number of elements below which operations stay on the calling thread.
+inline std::size_t get_parallel_threshold() noexcept {
+    return detail::parallel_threshold_setting().load(std::memory_order_relaxed);
+}
+
+inline void set_parallel_threshold(std::size_t threshold) noexcept {
+    detail::parallel_threshold_setting().store(threshold,
+                                               std::memory_order_relaxed);
+}
+
+namespace detail {
+
+// Elements per cache line, used as the grain of element-wise blocks so that
+// threads never write to the same line.
+template<class Tp_>
+constexpr std::size_t line_grain = std::max<std::size_t>(64 / sizeof(Tp_), 1);
+
+// Splits [0, count) into contiguous blocks and calls func(first, last) for
+// each of them from a team of threads. Every item stands for cost elements
+// of work. Anything below the parallel threshold runs on the calling thread,
+// as do calls made from inside a parallel region. Blocks are rounded to
+// multiples of grain.
+template<class Fn_>
+inline void parallel_for(std::size_t                  count,
+                         [[maybe_unused]] std::size_t cost,
+                         const Fn_&                   func,
+                         [[maybe_unused]] std::size_t grain = 1) {
+#if defined(_OPENMP)
+    auto nthreads = std::min(get_num_threads(), (count + grain - 1) / grain);
+    auto parallel = nthreads > 1 && count * cost >= get_parallel_threshold();
+    if (parallel && !omp_in_parallel()) {
+        auto block   = ((count + nthreads - 1) / nthreads + grain - 1) / grain
+                   * grain;
+        auto nblocks = (count + block - 1) / block;
+#pragma omp parallel num_threads(static_cast<int>(nthreads))
+        {
+            // The runtime may hand out fewer threads than requested
+            auto step = static_cast<std::size_t>(omp_get_num_threads());
+            for (auto i = static_cast<std::size_t>(omp_get_thread_num());
+                 i < nblocks; i += step)
+                func(i * block, std::min((i + 1) * block, count));
+        }
+        return;
+    }
+#endif
+    if (count != 0)
+        func(std::size_t(0), count);
+}
+
+} // namespace detail
+
+} // namespace ax
+
+#endif /* NDARRAY_PARALLEL_H_DEFINED */
@@ -12,7 +12,9 @@ namespace detail {
 
 template<class Tp_>
 void pretty_print(std::ostream& os, const ndarray<Tp_>& array, std::size_t ws) {
-    if (array.rank() == 1) {
+    if (array.rank() == 0) {
+        os << *array.data();
+    } else if (array.rank() == 1) {
         os << '[';
         for (std::size_t i = 0; i < array.extent(); ++i) {
             os << array[i];
@@ -52,6 +54,11 @@ inline std::ostream& operator<<(std::ostream& os, const ndarray<Tp_>& array) {
     return os << ")";
 }
 
+template<expression_like Ex_>
+inline std::ostream& operator<<(std::ostream& os, const Ex_& expr) {
+    return os << expr.eval();
+}
+
 } // namespace ax
 
 template<typename Ch_>
@@ -70,4 +77,8 @@ struct basic_ostream_formatter :
 template<class Tp_>
 struct std::formatter<ax::ndarray<Tp_>> : basic_ostream_formatter<char> {};
 
+template<class Fn_, class... Ops_>
+struct std::formatter<ax::ndarray_expression<Fn_, Ops_...>> :
+    basic_ostream_formatter<char> {};
+
 #endif /* NDARRAY_PRINT_H_DEFINED */
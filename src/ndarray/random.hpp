@@ -1,37 +1,620 @@
-#ifndef RANDOM_H_DEFINED
-#define RANDOM_H_DEFINED
+#ifndef NDARRAY_RANDOM_H_DEFINED
+#define NDARRAY_RANDOM_H_DEFINED
 
+#include "../core.hpp"
+#include "../simd/math.hpp"
 #include "core.hpp"
+#include "parallel.hpp"
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <numbers>
 #include <random>
+#include <type_traits>
+#include <vector>
 
 namespace ax::random {
 
-static std::random_device device_;
-static std::mt19937       generator_(device_());
-
-static inline auto randn(const std::vector<std::size_t>& shape,
-                         double                          mean  = 0.0f,
-                         double                          stdev = 1.0f) {
-    std::normal_distribution gaussian(mean, stdev);
-    auto                     array = ndarray<double>(shape);
-    auto                     ptr   = array.data();
-    for (std::size_t i = 0; i < array.size(); ++i)
-        ptr[i] = gaussian(generator_);
+namespace detail {
+
+constexpr std::uint32_t philox_m0 = 0xd2511f53;
+constexpr std::uint32_t philox_m1 = 0xcd9e8d57;
+constexpr std::uint32_t philox_w0 = 0x9e3779b9;
+constexpr std::uint32_t philox_w1 = 0xbb67ae85;
+
+// Multiplies the low halves of the words of x by m. x86 does this for
+// 64-bit lanes in one instruction, full 64-bit products slowly if at all.
+template<class Wd_>
+constexpr void mul_low(Wd_& x, std::uint32_t m) noexcept {
+    if constexpr (sizeof(Wd_) > simd::register_bytes) {
+        using part [[gnu::vector_size(simd::register_bytes)]] = std::uint64_t;
+        part parts[sizeof(Wd_) / sizeof(part)];
+        std::memcpy(parts, &x, sizeof(x));
+        for (auto& value : parts)
+            mul_low(value, m);
+        std::memcpy(&x, parts, sizeof(x));
+        return;
+    }
+#if defined(__AVX512F__)
+    if constexpr (sizeof(Wd_) == 64) {
+        x = std::bit_cast<Wd_>(_mm512_mul_epu32(std::bit_cast<__m512i>(x),
+                                                _mm512_set1_epi64(m)));
+        return;
+    }
+#endif
+#if defined(__AVX2__)
+    if constexpr (sizeof(Wd_) == 32) {
+        x = std::bit_cast<Wd_>(_mm256_mul_epu32(std::bit_cast<__m256i>(x),
+                                                _mm256_set1_epi64x(m)));
+        return;
+    }
+#endif
+#if defined(__SSE2__)
+    if constexpr (sizeof(Wd_) == 16) {
+        x = std::bit_cast<Wd_>(
+            _mm_mul_epu32(std::bit_cast<__m128i>(x), _mm_set1_epi64x(m)));
+        return;
+    }
+#endif
+    x = (x & 0xffffffff) * std::uint64_t(m);
+}
+
+// Ten rounds of Philox4x32 on a counter held in the low halves of four
+// words. Wd_ is an unsigned 64-bit integer or a vector of them, in which
+// case every lane runs its own counter.
+template<class Wd_>
+constexpr void
+philox(Wd_& c0, Wd_& c1, Wd_& c2, Wd_& c3, std::uint32_t k0, std::uint32_t k1) {
+    constexpr auto low = std::uint64_t(0xffffffff);
+    for (int round = 0; round < 10; ++round) {
+        Wd_ p0 = c0, p1 = c2;
+        mul_low(p0, philox_m0);
+        mul_low(p1, philox_m1);
+        c0     = (p1 >> 32) ^ c1 ^ k0;
+        c1     = p1 & low;
+        c2     = (p0 >> 32) ^ c3 ^ k1;
+        c3     = p0 & low;
+        k0 += philox_w0;
+        k1 += philox_w1;
+    }
+}
+
+// Blocks whose words are turned into values together. Every tile of a fill
+// starts at a fixed position, so the values never depend on how the tiles
+// are spread across threads.
+constexpr std::size_t tile_blocks = 64;
+constexpr std::size_t tile_words  = 4 * tile_blocks;
+
+// Values of Tp_ in a tile when each takes as many random bits as Tp_ has.
+template<class Tp_>
+constexpr std::size_t tile_values = sizeof(Tp_) == 8 ? tile_words / 2
+                                                     : tile_words;
+
+// 64-bit word j of a tile, made of the 32-bit words j and j + tile_words / 2.
+constexpr auto wide_word(const std::uint32_t* words, std::size_t j) noexcept {
+    return std::uint64_t(words[j + tile_words / 2]) << 32 | words[j];
+}
+
+// Uniform values in [0, 1) from the words of a tile, one per 32-bit word
+// for float and one per 64-bit word for double. With Open_ they lie in
+// (0, 1] instead, where the logarithm is finite.
+template<bool Open_, class Tp_>
+inline void unit_values(const std::uint32_t* words,
+                        Tp_* const           out,
+                        std::size_t          first,
+                        std::size_t          last) {
+    for (auto j = first; j < last; ++j) {
+        if constexpr (sizeof(Tp_) == 8)
+            out[j] = Open_ ? Tp_(wide_word(words, j) | 1) * Tp_(0x1p-64)
+                           : Tp_(wide_word(words, j) >> 11) * Tp_(0x1p-53);
+        else
+            out[j] = Open_ ? Tp_(words[j] | 1) * Tp_(0x1p-32)
+                           : Tp_(words[j] >> 8) * Tp_(0x1p-24);
+    }
+}
+
+// Blocks that count values of which per_tile come from a tile take up.
+constexpr auto tile_count(std::size_t count, std::size_t per_tile) noexcept {
+    return std::uint64_t((count + per_tile - 1) / per_tile) * tile_blocks;
+}
+
+// Threshold below which a uniform 32-bit word falls with probability p.
+constexpr auto word_threshold(double p) noexcept {
+    return static_cast<std::uint64_t>(p * 0x1p32);
+}
+
+// High 64 bits of word * range for a range of at most 2^32, which maps a
+// uniform word onto [0, range).
+constexpr auto scale_down(std::uint64_t word, std::uint64_t range) noexcept {
+    auto low = ((word & 0xffffffff) * range) >> 32;
+    return ((word >> 32) * range + low) >> 32;
+}
+
+} // namespace detail
+
+// Counter-based generator after Philox4x32-10 (Salmon et al., "Parallel
+// random numbers: as easy as 1, 2, 3"). A block of four 32-bit words is a
+// pure function of the seed and a 128-bit counter made of the stream and a
+// position, so any block can be computed without the ones before it. This
+// lets arrays be filled from any number of threads with the same result,
+// and gives every stream 2^64 blocks that never overlap another stream.
+class generator {
+ public:
+    using result_type = std::uint32_t;
+    using block_type  = std::array<std::uint32_t, 4>;
+
+    static constexpr auto min() noexcept {
+        return std::numeric_limits<result_type>::min();
+    }
+
+    static constexpr auto max() noexcept {
+        return std::numeric_limits<result_type>::max();
+    }
+
+    constexpr auto seed() const noexcept {
+        return seed_;
+    }
+
+    constexpr auto stream() const noexcept {
+        return stream_;
+    }
+
+    // Index of the next block to be handed out.
+    constexpr auto position() const noexcept {
+        return position_;
+    }
+
+    constexpr auto block(std::uint64_t position) const noexcept {
+        std::uint64_t c0 = position & 0xffffffff, c1 = position >> 32;
+        std::uint64_t c2 = stream_ & 0xffffffff, c3 = stream_ >> 32;
+        detail::philox(c0, c1, c2, c3, static_cast<std::uint32_t>(seed_),
+                       static_cast<std::uint32_t>(seed_ >> 32));
+        return block_type {static_cast<std::uint32_t>(c0),
+                           static_cast<std::uint32_t>(c1),
+                           static_cast<std::uint32_t>(c2),
+                           static_cast<std::uint32_t>(c3)};
+    }
+
+    // Hands out count blocks and returns the position of the first one.
+    // Words left over from operator() are dropped.
+    constexpr auto reserve(std::uint64_t count) noexcept {
+        auto first = position_;
+        position_ += count;
+        index_ = words_.size();
+        return first;
+    }
+
+    constexpr void discard(std::uint64_t count) noexcept {
+        reserve(count);
+    }
+
+    constexpr result_type operator()() noexcept {
+        if (index_ == words_.size()) {
+            words_ = block(position_++);
+            index_ = 0;
+        }
+        return words_[index_++];
+    }
+
+    // Words of the tile of blocks starting at position, word k of block i at
+    // index k * tile_blocks + i so that whole registers of blocks are
+    // computed and stored at a time.
+    void tile(std::uint64_t position, std::uint32_t* const words) const {
+        // Four registers of counters hide the latency of the multiplies
+        using lanes [[gnu::vector_size(4 * simd::register_bytes)]]
+        = std::uint64_t;
+        using halves [[gnu::vector_size(2 * simd::register_bytes)]]
+        = std::uint32_t;
+        constexpr auto width  = sizeof(lanes) / sizeof(std::uint64_t);
+        constexpr auto blocks = detail::tile_blocks;
+        auto           index  = lanes {};
+        for (std::size_t l = 0; l < width; ++l)
+            index[l] = l;
+        for (std::size_t i = 0; i < blocks; i += width) {
+            auto counter = index + (position + i);
+            lanes c[]    = {counter & 0xffffffff, counter >> 32,
+                            lanes {} + (stream_ & 0xffffffff),
+                            lanes {} + (stream_ >> 32)};
+            detail::philox(c[0], c[1], c[2], c[3],
+                           static_cast<std::uint32_t>(seed_),
+                           static_cast<std::uint32_t>(seed_ >> 32));
+            for (std::size_t k = 0; k < 4; ++k) {
+                auto half = __builtin_convertvector(c[k], halves);
+                std::memcpy(words + k * blocks + i, &half, sizeof(half));
+            }
+        }
+    }
+
+    // Writes count values of a sampler to data from the tiles starting at
+    // position first. Tiles are split across threads and the last one may be
+    // cut short, the values written never depend on the number of threads.
+    template<class Sm_>
+    void fill(std::uint64_t                   first,
+              typename Sm_::value_type* const data,
+              std::size_t                     count,
+              const Sm_&                      sampler) const {
+        constexpr auto per_tile = Sm_::per_tile;
+        auto           tiles    = count / per_tile;
+        ax::detail::parallel_for(
+            tiles, per_tile, [&](std::size_t begin, std::size_t end) {
+                std::uint32_t words[detail::tile_words];
+                for (auto i = begin; i < end; ++i) {
+                    tile(first + i * detail::tile_blocks, words);
+                    sampler(words, data + i * per_tile);
+                }
+            });
+        if (auto rest = count % per_tile) {
+            std::uint32_t            words[detail::tile_words];
+            typename Sm_::value_type values[per_tile];
+            tile(first + tiles * detail::tile_blocks, words);
+            sampler(words, values);
+            std::copy_n(values, rest, data + tiles * per_tile);
+        }
+    }
+
+    // Reserves the blocks for count values and writes them to data.
+    template<class Sm_>
+    void fill(typename Sm_::value_type* const data,
+              std::size_t                     count,
+              const Sm_&                      sampler) {
+        fill(reserve(detail::tile_count(count, Sm_::per_tile)), data, count,
+             sampler);
+    }
+
+    constexpr explicit generator(std::uint64_t seed   = 0,
+                                 std::uint64_t stream = 0) noexcept
+        : seed_(seed),
+          stream_(stream) {
+    }
+
+ private:
+    std::uint64_t seed_;
+    std::uint64_t stream_;
+    std::uint64_t position_ = 0;
+    block_type    words_    = {};
+    std::size_t   index_    = words_.size();
+};
+
+namespace detail {
+
+// Generator used when none is given, seeded from std::random_device until
+// seed() is called. Blocks are reserved under the mutex so that it can be
+// shared between threads.
+inline auto& default_generator() {
+    static auto gen = generator((std::uint64_t(std::random_device()()) << 32)
+                                | std::random_device()());
+    return gen;
+}
+
+inline auto& default_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+template<class Sm_>
+inline void fill_default(typename Sm_::value_type* const data,
+                         std::size_t                     count,
+                         const Sm_&                      sampler) {
+    auto lock  = std::unique_lock(default_mutex());
+    auto gen   = default_generator();
+    auto first = default_generator().reserve(tile_count(count,
+                                                        Sm_::per_tile));
+    lock.unlock();
+    gen.fill(first, data, count, sampler);
+}
+
+} // namespace detail
+
+// Samplers turn the words of a tile into per_tile values of value_type and
+// are what generator::fill writes. Floating point ones run on SIMD batches.
+
+// Uniform reals in [low, high).
+template<simd::vectorizable_float Tp_ = double>
+class uniform {
+ public:
+    using value_type = Tp_;
+
+    static constexpr std::size_t per_tile = detail::tile_values<Tp_>;
+
+    void operator()(const std::uint32_t* words, Tp_* const out) const {
+        detail::unit_values<false>(words, out, 0, per_tile);
+        for (std::size_t j = 0; j < per_tile; ++j)
+            out[j] = low_ + (high_ - low_) * out[j];
+    }
+
+    explicit uniform(Tp_ low = 0, Tp_ high = 1)
+        : low_(low),
+          high_(high) {
+        ax_assert(low <= high, "Low value cannot exceed high value!");
+    }
+
+ private:
+    Tp_ low_;
+    Tp_ high_;
+};
+
+// Uniform integers in [low, high], of which there may be up to 2^32. Each
+// takes 64 bits, so that the bias of mapping them onto the range stays
+// below 2^-32.
+template<std::integral Tp_ = int>
+class uniform_int {
+ public:
+    using value_type = Tp_;
+
+    static constexpr std::size_t per_tile = detail::tile_words / 2;
+
+    void operator()(const std::uint32_t* words, Tp_* const out) const {
+        for (std::size_t j = 0; j < per_tile; ++j)
+            out[j] = static_cast<Tp_>(
+                static_cast<std::uint64_t>(low_)
+                + detail::scale_down(detail::wide_word(words, j), range_));
+    }
+
+    uniform_int(Tp_ low, Tp_ high)
+        : low_(low),
+          range_(static_cast<std::uint64_t>(high)
+                 - static_cast<std::uint64_t>(low) + 1) {
+        ax_assert(low <= high, "Low value cannot exceed high value!");
+        ax_assert(range_ != 0 && range_ <= std::uint64_t(1) << 32,
+                  "Range of uniform integers cannot exceed 2^32!");
+    }
+
+ private:
+    Tp_           low_;
+    std::uint64_t range_;
+};
+
+// Normal reals by the Box-Muller transform, which turns the first half of
+// the uniform values of a tile into radii and the second half into angles.
+template<simd::vectorizable_float Tp_ = double>
+class normal {
+ public:
+    using value_type = Tp_;
+
+    static constexpr std::size_t per_tile = detail::tile_values<Tp_>;
+
+    void operator()(const std::uint32_t* words, Tp_* const out) const {
+        using batch    = simd::batch<Tp_>;
+        constexpr auto half = per_tile / 2;
+        detail::unit_values<true>(words, out, 0, half);
+        detail::unit_values<false>(words, out, half, per_tile);
+        auto mean  = batch::broadcast(mean_);
+        auto stdev = batch::broadcast(stdev_);
+        auto turn  = batch::broadcast(2 * std::numbers::pi_v<Tp_>);
+        for (std::size_t j = 0; j < half; j += batch::size) {
+            auto radius = simd::sqrt(batch::broadcast(-2)
+                                     * simd::log(batch::load(out + j)));
+            auto [s, c] = simd::sincos(turn * batch::load(out + half + j));
+            (mean + stdev * (radius * c)).store(out + j);
+            (mean + stdev * (radius * s)).store(out + half + j);
+        }
+    }
+
+    explicit normal(Tp_ mean = 0, Tp_ stdev = 1)
+        : mean_(mean),
+          stdev_(stdev) {
+        ax_assert(stdev >= 0, "Standard deviation cannot be negative!");
+    }
+
+ private:
+    Tp_ mean_;
+    Tp_ stdev_;
+};
+
+// Exponential reals of the given rate, -ln(u) / rate for u in (0, 1].
+template<simd::vectorizable_float Tp_ = double>
+class exponential {
+ public:
+    using value_type = Tp_;
+
+    static constexpr std::size_t per_tile = detail::tile_values<Tp_>;
+
+    void operator()(const std::uint32_t* words, Tp_* const out) const {
+        using batch = simd::batch<Tp_>;
+        detail::unit_values<true>(words, out, 0, per_tile);
+        auto rate = batch::broadcast(-rate_);
+        for (std::size_t j = 0; j < per_tile; j += batch::size)
+            (simd::log(batch::load(out + j)) / rate).store(out + j);
+    }
+
+    explicit exponential(Tp_ rate = 1)
+        : rate_(rate) {
+        ax_assert(rate > 0, "Rate must be positive!");
+    }
+
+ private:
+    Tp_ rate_;
+};
+
+// True with probability p, resolved to 2^-32.
+class bernoulli {
+ public:
+    using value_type = bool;
+
+    static constexpr std::size_t per_tile = detail::tile_words;
+
+    void operator()(const std::uint32_t* words, bool* const out) const {
+        for (std::size_t j = 0; j < per_tile; ++j)
+            out[j] = words[j] < threshold_;
+    }
+
+    explicit bernoulli(double p = 0.5)
+        : threshold_(detail::word_threshold(p)) {
+        ax_assert(p >= 0 && p <= 1, "Probability must lie in [0, 1]!");
+    }
+
+ private:
+    std::uint64_t threshold_;
+};
+
+// Indices drawn with probabilities proportional to weights, by Walker's
+// alias method as laid out by Vose. Each index picks a column uniformly
+// from the high half of a 64-bit word and keeps it or takes its alias
+// depending on the low half.
+class categorical {
+ public:
+    using value_type = std::size_t;
+
+    static constexpr std::size_t per_tile = detail::tile_words / 2;
+
+    void operator()(const std::uint32_t* words, std::size_t* const out) const {
+        auto count = static_cast<std::uint64_t>(columns_.size());
+        for (std::size_t j = 0; j < per_tile; ++j) {
+            auto word   = detail::wide_word(words, j);
+            auto column = static_cast<std::size_t>((word >> 32) * count >> 32);
+            auto& entry = columns_[column];
+            out[j] = (word & 0xffffffff) < entry.threshold ? column
+                                                           : entry.alias;
+        }
+    }
+
+    explicit categorical(const std::vector<double>& weights)
+        : columns_(weights.size()) {
+        auto count = weights.size();
+        ax_assert(count > 0 && count <= std::size_t(1) << 32,
+                  "Number of categories must lie in [1, 2^32]!");
+        auto total = 0.0;
+        for (auto weight : weights) {
+            ax_assert(weight >= 0 && std::isfinite(weight),
+                      "Weights must be finite and non-negative!");
+            total += weight;
+        }
+        ax_assert(total > 0, "Weights cannot all be zero!");
+
+        // Columns below the average are topped up from those above it
+        auto scaled = std::vector<double>(count);
+        auto small  = std::vector<std::size_t>();
+        auto large  = std::vector<std::size_t>();
+        for (std::size_t i = 0; i < count; ++i) {
+            scaled[i] = weights[i] * static_cast<double>(count) / total;
+            (scaled[i] < 1 ? small : large).push_back(i);
+        }
+        while (!small.empty() && !large.empty()) {
+            auto less = small.back();
+            auto more = large.back();
+            small.pop_back();
+            columns_[less] = {detail::word_threshold(scaled[less]), more};
+            scaled[more]   = (scaled[more] + scaled[less]) - 1;
+            if (scaled[more] < 1) {
+                large.pop_back();
+                small.push_back(more);
+            }
+        }
+        // Whatever is left is a full column up to rounding
+        for (auto i : small)
+            columns_[i] = {detail::word_threshold(1), i};
+        for (auto i : large)
+            columns_[i] = {detail::word_threshold(1), i};
+    }
+
+ private:
+    struct column {
+        std::uint64_t threshold = 0; // Keeps the column below it
+        std::size_t   alias     = 0;
+    };
+
+    std::vector<column> columns_;
+};
+
+// Makes the default generator reproducible from here on.
+inline void seed(std::uint64_t seed, std::uint64_t stream = 0) {
+    auto lock                   = std::scoped_lock(detail::default_mutex());
+    detail::default_generator() = generator(seed, stream);
+}
+
+// Fills an array with values of a sampler, straight into its buffer when it
+// is row-major. Other layouts get the same values at the same indices.
+template<class Tp_, class Sm_>
+    requires(std::same_as<Tp_, typename Sm_::value_type>)
+inline void fill(generator& gen, ndarray<Tp_>& array, const Sm_& sampler) {
+    if (!array.is_contiguous(stride_type::row_major)) {
+        auto values = ndarray<Tp_>(array.shape());
+        gen.fill(values.data(), values.size(), sampler);
+        array.apply_inplace([](Tp_, Tp_ value) { return value; },
+                            std::move(values));
+        return;
+    }
+    gen.fill(array.data(), array.size(), sampler);
+}
+
+template<class Tp_, class Sm_>
+    requires(std::same_as<Tp_, typename Sm_::value_type>)
+inline void fill(ndarray<Tp_>& array, const Sm_& sampler) {
+    if (!array.is_contiguous(stride_type::row_major)) {
+        auto values = ndarray<Tp_>(array.shape());
+        detail::fill_default(values.data(), values.size(), sampler);
+        array.apply_inplace([](Tp_, Tp_ value) { return value; },
+                            std::move(values));
+        return;
+    }
+    detail::fill_default(array.data(), array.size(), sampler);
+}
+
+// New array of the given shape holding values of a sampler.
+template<class Sm_>
+inline auto sample(generator&                      gen,
+                   const std::vector<std::size_t>& shape,
+                   const Sm_&                      sampler) {
+    auto array = ndarray<typename Sm_::value_type>(shape);
+    gen.fill(array.data(), array.size(), sampler);
+    return array;
+}
+
+template<class Sm_>
+inline auto sample(const std::vector<std::size_t>& shape, const Sm_& sampler) {
+    auto array = ndarray<typename Sm_::value_type>(shape);
+    detail::fill_default(array.data(), array.size(), sampler);
     return array;
 }
 
-static inline auto
+template<simd::vectorizable_float Tp_ = double>
+inline auto randn(generator&                      gen,
+                  const std::vector<std::size_t>& shape,
+                  std::type_identity_t<Tp_>       mean  = 0,
+                  std::type_identity_t<Tp_>       stdev = 1) {
+    return sample(gen, shape, normal<Tp_>(mean, stdev));
+}
+
+template<simd::vectorizable_float Tp_ = double>
+inline auto randn(const std::vector<std::size_t>& shape,
+                  std::type_identity_t<Tp_>       mean  = 0,
+                  std::type_identity_t<Tp_>       stdev = 1) {
+    return sample(shape, normal<Tp_>(mean, stdev));
+}
+
+// Uniform reals in [0, 1).
+template<simd::vectorizable_float Tp_ = double>
+inline auto rand(generator& gen, const std::vector<std::size_t>& shape) {
+    return sample(gen, shape, uniform<Tp_>());
+}
+
+template<simd::vectorizable_float Tp_ = double>
+inline auto rand(const std::vector<std::size_t>& shape) {
+    return sample(shape, uniform<Tp_>());
+}
+
+inline auto randint(generator&                      gen,
+                    const std::vector<std::size_t>& shape,
+                    int                             low,
+                    int                             high) {
+    ax_assert(low < high, "Low value cannot exceed or be equal to high value!");
+    return sample(gen, shape, uniform_int<int>(low, high));
+}
+
+inline auto
 randint(const std::vector<std::size_t>& shape, int low, int high) {
     ax_assert(low < high, "Low value cannot exceed or be equal to high value!");
-    std::uniform_int_distribution uniform(low, high);
-    auto                          array = ndarray<int>(shape);
-    auto                          ptr   = array.data();
-    for (std::size_t i = 0; i < array.size(); ++i)
-        ptr[i] = uniform(generator_);
-    return array;
+    return sample(shape, uniform_int<int>(low, high));
 }
 
 } // namespace ax::random
 
-#endif /* RANDOM_H_DEFINED */
+#endif /* NDARRAY_RANDOM_H_DEFINED */
@@ -0,0 +1,438 @@
+#ifndef NDARRAY_REDUCE_H_DEFINED
+#define NDARRAY_REDUCE_H_DEFINED
+
+#include "concepts.hpp"
+#include "core.hpp"
+#include "extents.hpp"
+#include "layout.hpp"
+#include "memory.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <initializer_list>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <type_traits>
+
+namespace ax {
+
+// Axes to reduce over, either a single axis or a braced list of them.
+class axis_set : public shape_type {
+ public:
+    constexpr axis_set(std::size_t axis)
+        : shape_type {axis} {
+    }
+
+    constexpr axis_set(std::initializer_list<std::size_t> axes)
+        : shape_type(axes) {
+    }
+
+    constexpr axis_set(std::span<const std::size_t> axes)
+        : shape_type(axes) {
+    }
+};
+
+// Treatment of NaN by min, max and the index variants.
+enum class nan_policy : int {
+    propagate, // Any NaN makes the result NaN, or the index of the first NaN
+    omit       // NaN elements are skipped
+};
+
+namespace detail {
+
+template<class Tp_>
+constexpr auto highest() noexcept {
+    if constexpr (std::numeric_limits<Tp_>::has_infinity)
+        return std::numeric_limits<Tp_>::infinity();
+    else
+        return std::numeric_limits<Tp_>::max();
+}
+
+template<class Tp_>
+constexpr auto lowest() noexcept {
+    if constexpr (std::numeric_limits<Tp_>::has_infinity)
+        return -std::numeric_limits<Tp_>::infinity();
+    else
+        return std::numeric_limits<Tp_>::lowest();
+}
+
+// Reducers describe a reduction by the state kept per output element: init()
+// creates it, step() folds in one element together with its position among
+// the reduced elements (row-major over the reduced axes) and result() turns
+// the final state into the output value given the number of elements.
+template<class Tp_>
+struct sum_reducer {
+    constexpr auto init() const noexcept {
+        return Tp_ {};
+    }
+
+    constexpr void step(Tp_& state, const Tp_& value, std::size_t) const {
+        state += value;
+    }
+
+    constexpr auto result(const Tp_& state, std::size_t) const {
+        return state;
+    }
+};
+
+template<class Tp_>
+struct prod_reducer {
+    constexpr auto init() const noexcept {
+        return Tp_ {1};
+    }
+
+    constexpr void step(Tp_& state, const Tp_& value, std::size_t) const {
+        state *= value;
+    }
+
+    constexpr auto result(const Tp_& state, std::size_t) const {
+        return state;
+    }
+};
+
+// Integer statistics are computed in double like the rest of the math
+// functions do for integer inputs.
+template<class Tp_>
+using floating_type
+    = std::conditional_t<std::is_floating_point_v<Tp_>, Tp_, double>;
+
+template<class Tp_, class Rt_ = floating_type<Tp_>>
+struct mean_reducer {
+    constexpr auto init() const noexcept {
+        return Rt_ {};
+    }
+
+    constexpr void step(Rt_& state, const Tp_& value, std::size_t) const {
+        state += static_cast<Rt_>(value);
+    }
+
+    constexpr auto result(const Rt_& state, std::size_t count) const {
+        return state / static_cast<Rt_>(count);
+    }
+};
+
+// Variance with Welford's update, which stays accurate in a single pass
+// where the sum of squares would cancel.
+template<class Tp_, class Rt_ = floating_type<Tp_>>
+struct var_reducer {
+    struct state_type {
+        std::size_t count = 0;
+        Rt_         mean  = 0;
+        Rt_         m2    = 0;
+    };
+
+    std::size_t ddof = 0;
+
+    constexpr auto init() const noexcept {
+        return state_type {};
+    }
+
+    constexpr void
+    step(state_type& state, const Tp_& value, std::size_t) const {
+        auto delta = static_cast<Rt_>(value) - state.mean;
+        state.count++;
+        state.mean += delta / static_cast<Rt_>(state.count);
+        state.m2 += delta * (static_cast<Rt_>(value) - state.mean);
+    }
+
+    constexpr auto result(const state_type& state, std::size_t count) const {
+        return state.m2 / (static_cast<Rt_>(count) - static_cast<Rt_>(ddof));
+    }
+};
+
+template<class Tp_>
+constexpr auto is_nan(const Tp_& value) noexcept {
+    return value != value;
+}
+
+// Extremes remember whether any element was kept, so that a slice of
+// nothing but omitted NaN gives NaN rather than the seed.
+template<class Tp_>
+struct extreme_state {
+    Tp_  value;
+    bool kept = false;
+};
+
+template<class Tp_>
+constexpr auto extreme_result(const extreme_state<Tp_>& state) {
+    if constexpr (std::numeric_limits<Tp_>::has_quiet_NaN)
+        if (!state.kept)
+            return std::numeric_limits<Tp_>::quiet_NaN();
+    return state.value;
+}
+
+template<class Tp_>
+struct min_reducer {
+    nan_policy policy = nan_policy::propagate;
+
+    constexpr auto init() const noexcept {
+        return extreme_state<Tp_> {highest<Tp_>()};
+    }
+
+    constexpr void
+    step(extreme_state<Tp_>& state, const Tp_& value, std::size_t) const {
+        if (value < state.value)
+            state.value = value;
+        else if (policy == nan_policy::propagate && is_nan(value))
+            state.value = value;
+        state.kept = state.kept || !is_nan(value);
+    }
+
+    constexpr auto
+    result(const extreme_state<Tp_>& state, std::size_t) const {
+        return extreme_result(state);
+    }
+};
+
+template<class Tp_>
+struct max_reducer {
+    nan_policy policy = nan_policy::propagate;
+
+    constexpr auto init() const noexcept {
+        return extreme_state<Tp_> {lowest<Tp_>()};
+    }
+
+    constexpr void
+    step(extreme_state<Tp_>& state, const Tp_& value, std::size_t) const {
+        if (value > state.value)
+            state.value = value;
+        else if (policy == nan_policy::propagate && is_nan(value))
+            state.value = value;
+        state.kept = state.kept || !is_nan(value);
+    }
+
+    constexpr auto
+    result(const extreme_state<Tp_>& state, std::size_t) const {
+        return extreme_result(state);
+    }
+};
+
+constexpr auto no_index = static_cast<std::size_t>(-1);
+
+template<class Tp_>
+struct arg_state {
+    Tp_         value;
+    std::size_t index = no_index;
+};
+
+// Index reductions keep the first occurrence of the extreme, or of a NaN
+// when propagating. The elements are not visited in row-major order so ties
+// are broken on the position. Without any candidate, i.e. when every element
+// is an omitted NaN, there is no index to give.
+template<class Tp_, bool Max_>
+struct arg_reducer {
+    nan_policy policy = nan_policy::propagate;
+
+    constexpr auto init() const noexcept {
+        return arg_state<Tp_> {Max_ ? lowest<Tp_>() : highest<Tp_>()};
+    }
+
+    constexpr void
+    step(arg_state<Tp_>& state, const Tp_& value, std::size_t pos) const {
+        if (is_nan(value)) {
+            if (policy == nan_policy::propagate
+                && (!is_nan(state.value) || pos < state.index))
+                state = {value, pos};
+        } else if (!is_nan(state.value)) {
+            auto better = Max_ ? value > state.value : value < state.value;
+            if (better || (value == state.value && pos < state.index))
+                state = {value, pos};
+        }
+    }
+
+    constexpr auto result(const arg_state<Tp_>& state, std::size_t) const {
+        ax_assert(state.index != no_index,
+                  (Max_ ? "Cannot find argmax of only NaN!"
+                        : "Cannot find argmin of only NaN!"));
+        return state.index;
+    }
+};
+
+template<class Tp_>
+using argmin_reducer = arg_reducer<Tp_, false>;
+
+template<class Tp_>
+using argmax_reducer = arg_reducer<Tp_, true>;
+
+// Loop nest of a reduction. Every axis of the input carries its stride in
+// the input, the stride of the output element it accumulates into (zero
+// along reduced axes) and the stride of its position among the reduced
+// elements (zero along kept axes). The axes are ordered by decreasing input
+// stride so the innermost loop runs over contiguous memory, and axes that
+// are contiguous in all three are merged.
+struct reduce_plan {
+    shape_type  shape;
+    shape_type  istrides;
+    shape_type  ostrides;
+    shape_type  pstrides;
+    shape_type  out_shape;
+    std::size_t count = 1; // Number of elements reduced into each output
+};
+
+inline auto make_reduce_plan(const shape_type&            shape,
+                             const shape_type&            strides,
+                             std::span<const std::size_t> axes,
+                             bool                         keepdims) {
+    auto rank    = shape.size();
+    auto reduced = static_vector<bool, max_rank>(rank, false);
+    for (auto axis : axes) {
+        ax_assert(axis < rank, "Axis cannot exceed rank of array!");
+        ax_assert(!reduced[axis], "Cannot reduce an axis more than once!");
+        reduced[axis] = true;
+    }
+
+    auto        plan     = reduce_plan {};
+    auto        ostrides = shape_type(rank, 0);
+    auto        pstrides = shape_type(rank, 0);
+    std::size_t osize    = 1;
+    for (auto i = rank; i-- > 0;) {
+        if (reduced[i]) {
+            pstrides[i] = plan.count;
+            plan.count *= shape[i];
+        } else {
+            ostrides[i] = osize;
+            osize *= shape[i];
+        }
+    }
+    for (std::size_t i = 0; i < rank; ++i)
+        if (!reduced[i] || keepdims)
+            plan.out_shape.push_back(reduced[i] ? 1 : shape[i]);
+
+    auto nest = loop_nest(shape, std::array {strides, ostrides, pstrides});
+
+    // The walk always has an outer axis to split across threads and an
+    // inner axis, a missing one is padded with a unit axis
+    if (nest.rank() < 2) {
+        plan.shape.push_back(1);
+        plan.istrides.push_back(0);
+        plan.ostrides.push_back(0);
+        plan.pstrides.push_back(0);
+    }
+    auto istrides = nest.strides(strides);
+    ostrides      = nest.strides(ostrides);
+    pstrides      = nest.strides(pstrides);
+    for (std::size_t i = 0; i < nest.rank(); ++i) {
+        plan.shape.push_back(nest.shape()[i]);
+        plan.istrides.push_back(istrides[i]);
+        plan.ostrides.push_back(ostrides[i]);
+        plan.pstrides.push_back(pstrides[i]);
+    }
+    return plan;
+}
+
+// Walks entries [first, last) of the outer axis of a plan. The inner axis
+// keeps the state in a register when it is reduced and streams the states
+// alongside the input when it is kept.
+template<class Tp_, class St_, class Rd_>
+inline void reduce_walk(const Tp_* const   data,
+                        St_* const         states,
+                        const Rd_&         reducer,
+                        const reduce_plan& plan,
+                        std::size_t        first,
+                        std::size_t        last) {
+    auto inner   = plan.shape.size() - 1;
+    auto dim     = plan.shape[inner];
+    auto is      = static_cast<std::ptrdiff_t>(plan.istrides[inner]);
+    auto os      = plan.ostrides[inner];
+    auto ps      = plan.pstrides[inner];
+    auto strides = std::array {plan.istrides, plan.ostrides, plan.pstrides};
+
+    std::size_t rows = 1;
+    for (std::size_t i = 1; i < inner; ++i)
+        rows *= plan.shape[i];
+
+    walk_rows(plan.shape, strides, first * rows, last * rows,
+              [&](const auto&, const auto& offsets) {
+                  auto row  = data + offsets[0];
+                  auto out  = states + offsets[1];
+                  auto poff = static_cast<std::size_t>(offsets[2]);
+                  auto at   = [is](std::size_t i) {
+                      return static_cast<std::ptrdiff_t>(i) * is;
+                  };
+                  if (os == 0) {
+                      auto state = *out;
+                      for (std::size_t i = 0; i < dim; ++i)
+                          reducer.step(state, row[at(i)], poff + i * ps);
+                      *out = state;
+                  } else if (is == 1 && os == 1) {
+                      for (std::size_t i = 0; i < dim; ++i)
+                          reducer.step(out[i], row[i], poff + i * ps);
+                  } else {
+                      for (std::size_t i = 0; i < dim; ++i)
+                          reducer.step(out[i * os], row[at(i)], poff + i * ps);
+                  }
+              });
+}
+
+// Reduces an array over the given axes in a single pass over its elements.
+// The per-output states are allocated from the array pool. When the outer
+// axis of the walk is kept, the outputs of different threads are disjoint
+// and the walk is split across threads.
+template<class Tp_, class Rd_>
+inline auto reduce_states(const Tp_* const             data,
+                          const shape_type&            shape,
+                          const shape_type&            strides,
+                          std::span<const std::size_t> axes,
+                          bool                         keepdims,
+                          const Rd_&                   reducer) {
+    auto plan   = make_reduce_plan(shape, strides, axes, keepdims);
+    auto size   = ranges::product(plan.out_shape);
+    auto states = allocate_buffer<decltype(reducer.init())>(size);
+    std::fill_n(states.get(), size, reducer.init());
+
+    auto count = ranges::product(shape);
+    auto span  = trace::span("reduce", count, count * sizeof(Tp_));
+    auto inner = plan.shape.size() - 1;
+    if (plan.ostrides[inner] == 0)
+        span.path("inner_reduced");
+    else if (plan.istrides[inner] == 1 && plan.ostrides[inner] == 1)
+        span.path("inner_kept");
+    else
+        span.path("inner_kept_strided");
+
+    auto walk = [&](std::size_t first, std::size_t last) {
+        reduce_walk(data, states.get(), reducer, plan, first, last);
+    };
+    auto outer = plan.shape[0];
+    if (plan.ostrides[0] != 0)
+        parallel_for(outer, ranges::product(plan.shape) / outer, walk);
+    else
+        walk(0, outer);
+    return std::make_pair(std::move(plan), std::move(states));
+}
+
+template<class Tp_, class Rd_>
+inline auto reduce(const ndarray<Tp_>&          array,
+                   std::span<const std::size_t> axes,
+                   bool                         keepdims,
+                   const Rd_&                   reducer) {
+    auto [plan, states] = reduce_states(array.data(), array.shape(),
+                                        array.strides(), axes, keepdims,
+                                        reducer);
+    using Rt_ = decltype(reducer.result(states[0], plan.count));
+    auto result = ndarray<Rt_>(plan.out_shape);
+    auto data   = result.data();
+    for (std::size_t i = 0; i < result.size(); ++i)
+        data[i] = reducer.result(states[i], plan.count);
+    return result;
+}
+
+// Reduces every axis of an array into a single value.
+template<class Tp_, class Rd_>
+inline auto reduce_all(const ndarray<Tp_>& array, const Rd_& reducer) {
+    auto axes = shape_type(array.rank());
+    std::iota(axes.begin(), axes.end(), 0);
+    auto [plan, states] = reduce_states(array.data(), array.shape(),
+                                        array.strides(), axes, false, reducer);
+    return reducer.result(states[0], plan.count);
+}
+
+} // namespace detail
+
+} // namespace ax
+
+#endif /* NDARRAY_REDUCE_H_DEFINED */
@@ -0,0 +1,385 @@
+#ifndef NDARRAY_SELECT_H_DEFINED
+#define NDARRAY_SELECT_H_DEFINED
+
+#include "../core.hpp"
+#include "../simd/select.hpp"
+#include "core.hpp"
+#include "expression.hpp"
+#include "layout.hpp"
+#include "parallel.hpp"
+#include "slice.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ax {
+
+namespace detail {
+
+// Copies src[idx[k]] to dst[k] for count positions along an axis of the
+// given length. The loads are independent, so the core overlaps them in
+// whatever order the positions come, and scalar loads beat the gather
+// instructions at that.
+template<class Tp_, std::integral Ix_>
+inline void gather_kernel(Tp_* const       dst,
+                          const Tp_* const src,
+                          std::size_t      length,
+                          const Ix_* const idx,
+                          std::size_t      count) {
+    for (std::size_t k = 0; k < count; ++k)
+        dst[k] = src[wrap_index(idx[k], length)];
+}
+
+// Copies the count elements of src whose mask is set to dst, in order. The
+// scalar loop stops at the last of them, so its unconditional writes stay
+// within dst.
+template<class Tp_>
+inline void compress_kernel(Tp_* const        dst,
+                            const Tp_* const  src,
+                            const bool* const mask,
+                            std::size_t       count) {
+    std::size_t i = 0;
+    std::size_t j = 0;
+    if constexpr (simd::native_compress && simd::vectorizable<Tp_>) {
+        using batch = simd::batch<Tp_>;
+        for (; j + batch::size <= count; i += batch::size)
+            j += simd::compress_store(dst + j, batch::load(src + i), mask + i);
+    }
+    for (; j < count; ++i) {
+        dst[j] = src[i];
+        j += mask[i];
+    }
+}
+
+// Writes first + i for the count positions i where the mask is set to dst.
+inline void compress_positions(std::int64_t* const dst,
+                               std::int64_t        first,
+                               const bool* const   mask,
+                               std::size_t         count) {
+    std::size_t i = 0;
+    std::size_t j = 0;
+    if constexpr (simd::native_compress) {
+        using batch = simd::batch<std::int64_t>;
+        auto lanes  = typename batch::native_type {};
+        for (std::size_t k = 0; k < batch::size; ++k)
+            lanes[k] = first + static_cast<std::int64_t>(k);
+        auto positions = batch(lanes);
+        auto step      = batch::broadcast(batch::size);
+        for (; j + batch::size <= count; i += batch::size) {
+            j += simd::compress_store(dst + j, positions, mask + i);
+            positions = positions + step;
+        }
+    }
+    for (; j < count; ++i) {
+        dst[j] = first + static_cast<std::int64_t>(i);
+        j += mask[i];
+    }
+}
+
+// Overwrites the elements of dst whose mask is set with the first count
+// values, in order.
+template<class Tp_>
+inline void expand_kernel(Tp_* const        dst,
+                          const Tp_* const  values,
+                          const bool* const mask,
+                          std::size_t       count) {
+    std::size_t i = 0;
+    std::size_t j = 0;
+    if constexpr (simd::native_compress && simd::vectorizable<Tp_>) {
+        using batch = simd::batch<Tp_>;
+        for (; j + batch::size <= count; i += batch::size) {
+            auto [value, n] = simd::expand_load(values + j,
+                                                batch::load(dst + i), mask + i);
+            value.store(dst + i);
+            j += n;
+        }
+    }
+    for (; j < count; ++i) {
+        dst[i] = mask[i] ? values[j] : dst[i];
+        j += mask[i];
+    }
+}
+
+// Number of set elements of a mask ahead of each of its blocks of
+// scan_block_size, followed by the total. Blocks are counted across threads
+// so that they can then be filled independently.
+inline auto mask_offsets(const bool* const mask, std::size_t size) {
+    auto nblocks = (size + scan_block_size - 1) / scan_block_size;
+    auto offsets = std::vector<std::size_t>(nblocks + 1);
+    parallel_for(nblocks, scan_block_size,
+                 [&](std::size_t first, std::size_t last) {
+                     for (auto b = first; b < last; ++b) {
+                         auto begin = mask + b * scan_block_size;
+                         auto end   = mask + std::min((b + 1) * scan_block_size,
+                                                      size);
+                         offsets[b + 1] = static_cast<std::size_t>(
+                             std::count(begin, end, true));
+                     }
+                 });
+    std::inclusive_scan(offsets.begin(), offsets.end(), offsets.begin());
+    return offsets;
+}
+
+// Calls func(block, first, count) for each block of a mask, with first the
+// start of the block and count its set elements, from a team of threads.
+template<class Fn_>
+inline void for_mask_blocks(const std::vector<std::size_t>& offsets,
+                            const Fn_&                      func) {
+    parallel_for(offsets.size() - 1, scan_block_size,
+                 [&](std::size_t first, std::size_t last) {
+                     for (auto b = first; b < last; ++b)
+                         func(b, b * scan_block_size,
+                              offsets[b + 1] - offsets[b]);
+                 });
+}
+
+// Offset of the element at a position in the row-major order of an array.
+inline auto unravel_offset(const shape_type& shape,
+                           const shape_type& strides,
+                           std::size_t       index) {
+    std::size_t offset = 0;
+    for (auto i = shape.size(); i-- > 0;) {
+        offset += index % shape[i] * strides[i];
+        index /= shape[i];
+    }
+    return static_cast<std::ptrdiff_t>(offset);
+}
+
+} // namespace detail
+
+// Slices of an array at the given positions along an axis, in the order of
+// the positions, which may repeat. The axis is replaced by the axes of the
+// indices and negative positions count from the end of the axis. Large
+// index sets are split across threads.
+template<class Tp_, std::integral Ix_>
+inline auto take(const ndarray<Tp_>& array,
+                 const ndarray<Ix_>& indices,
+                 std::size_t         axis) {
+    auto& shape = array.shape();
+    auto  rank  = array.rank();
+    ax_assert(axis < rank, "Axis cannot exceed rank of array!");
+    ax_assert(rank + indices.rank() - 1 <= max_rank,
+              "Cannot take more axes than the maximum rank!");
+    auto new_shape = shape_type(shape.begin(), shape.begin() + axis);
+    for (auto extent : indices.shape())
+        new_shape.push_back(extent);
+    for (auto i = axis + 1; i < rank; ++i)
+        new_shape.push_back(shape[i]);
+    auto result = ndarray<Tp_>(new_shape);
+    if (result.size() == 0)
+        return result;
+
+    const auto src    = array.as_layout(stride_type::row_major);
+    const auto idx    = indices.as_layout(stride_type::row_major);
+    auto       length = shape[axis];
+    auto       inner  = ranges::product(shape | std::views::drop(axis + 1));
+    auto       outer  = ranges::product(shape | std::views::take(axis));
+    auto       count  = idx.size();
+    auto       data   = src.data();
+    auto       ids    = idx.data();
+    auto       out    = result.data();
+    auto       span   = trace::span("take", result.size(),
+                                    result.size() * sizeof(Tp_));
+    span.path(inner == 1 ? "gather" : "rows");
+
+    // Rows of inner elements, one per outer position and index
+    auto gather = [&](std::size_t first, std::size_t last) {
+        for (auto r = first; r < last;) {
+            auto o    = r / count;
+            auto k    = r % count;
+            auto end  = std::min(last, (o + 1) * count);
+            auto from = data + o * length * inner;
+            auto dst  = out + r * inner;
+            if (inner == 1) {
+                detail::gather_kernel(dst, from, length, ids + k, end - r);
+            } else {
+                for (auto j = k; j < k + end - r; ++j, dst += inner) {
+                    auto i = detail::wrap_index(ids[j], length);
+                    std::copy_n(from + i * inner, inner, dst);
+                }
+            }
+            r = end;
+        }
+    };
+    detail::parallel_for(outer * count, inner, gather,
+                         inner == 1 ? detail::line_grain<Tp_> : 1);
+    return result;
+}
+
+// Elements of an array at the given positions in its row-major order,
+// shaped like the indices.
+template<class Tp_, std::integral Ix_>
+inline auto take(const ndarray<Tp_>& array, const ndarray<Ix_>& indices) {
+    return take(array.flatten(), indices, 0);
+}
+
+// Writes values to the elements of an array at the given positions in its
+// row-major order, negative positions counting from the end. The values go
+// in the order of the indices, a single value goes to every position. Which
+// value a repeated position ends up with is unspecified once the writes are
+// split across threads.
+template<class Tp_, std::integral Ix_>
+inline auto& put(ndarray<Tp_>&       array,
+                 const ndarray<Ix_>& indices,
+                 const ndarray<Tp_>& values) {
+    auto count = indices.size();
+    ax_assert(values.size() == count || values.size() == 1,
+              "Number of values does not match number of indices!");
+    const auto idx     = indices.as_layout(stride_type::row_major);
+    const auto vals    = values.as_layout(stride_type::row_major);
+    auto       size    = array.size();
+    auto&      shape   = array.shape();
+    auto&      strides = array.strides();
+    auto       dense   = array.is_contiguous(stride_type::row_major);
+    auto       data    = array.data();
+    auto       ids     = idx.data();
+    auto       src     = vals.data();
+    auto       step    = values.size() == 1 ? 0 : 1;
+    auto       span    = trace::span("put", count, count * sizeof(Tp_));
+    span.path(dense ? "contiguous" : "unravel");
+    detail::parallel_for(count, 1, [&](std::size_t first, std::size_t last) {
+        for (auto k = first; k < last; ++k) {
+            auto i = detail::wrap_index(ids[k], size);
+            auto offset
+                = dense ? i
+                        : detail::unravel_offset(shape, strides,
+                                                 static_cast<std::size_t>(i));
+            data[offset] = src[k * step];
+        }
+    });
+    return array;
+}
+
+template<class Tp_, std::integral Ix_>
+inline auto& put(ndarray<Tp_>&              array,
+                 const ndarray<Ix_>&        indices,
+                 std::type_identity_t<Tp_> value) {
+    return put(array, indices, ndarray<Tp_>(value, shape_type {1}));
+}
+
+// Row-major positions of the set elements of a mask.
+inline auto flatnonzero(const ndarray<bool>& mask) {
+    const auto m       = mask.as_layout(stride_type::row_major);
+    auto       bits    = m.data();
+    auto       offsets = detail::mask_offsets(bits, m.size());
+    auto       result  = ndarray<std::int64_t>(shape_type {offsets.back()});
+    auto       out     = result.data();
+    auto       span    = trace::span("flatnonzero", m.size(), m.size());
+    span.path(simd::native_compress ? "simd_compress" : "scalar");
+    detail::for_mask_blocks(offsets, [&](std::size_t b, std::size_t first,
+                                         std::size_t count) {
+        detail::compress_positions(out + offsets[b],
+                                   static_cast<std::int64_t>(first),
+                                   bits + first, count);
+    });
+    return result;
+}
+
+// Elements of an array where the mask of the same shape is set, in
+// row-major order, as a[mask] in NumPy. Large arrays are split into fixed
+// blocks across threads, each writing its elements after those of the
+// blocks ahead of it.
+template<class Tp_>
+inline auto compress(const ndarray<bool>& mask, const ndarray<Tp_>& array) {
+    ax_assert(mask.shape() == array.shape(),
+              "Mask does not match shape of array!");
+    const auto m       = mask.as_layout(stride_type::row_major);
+    const auto src     = array.as_layout(stride_type::row_major);
+    auto       bits    = m.data();
+    auto       data    = src.data();
+    auto       offsets = detail::mask_offsets(bits, m.size());
+    auto       result  = ndarray<Tp_>(shape_type {offsets.back()});
+    auto       out     = result.data();
+    auto       span    = trace::span("compress", m.size(),
+                                     m.size() * sizeof(Tp_));
+    span.path(simd::native_compress && simd::vectorizable<Tp_>
+                  ? "simd_compress"
+                  : "scalar");
+    detail::for_mask_blocks(offsets, [&](std::size_t b, std::size_t first,
+                                         std::size_t count) {
+        detail::compress_kernel(out + offsets[b], data + first, bits + first,
+                                count);
+    });
+    return result;
+}
+
+// Slices of an array along an axis where a mask as long as the axis is set.
+template<class Tp_>
+inline auto compress(const ndarray<bool>& mask,
+                     const ndarray<Tp_>&  array,
+                     std::size_t          axis) {
+    ax_assert(axis < array.rank(), "Axis cannot exceed rank of array!");
+    ax_assert(mask.rank() == 1 && mask.size() == array.shape()[axis],
+              "Mask does not match length of axis!");
+    return take(array, flatnonzero(mask), axis);
+}
+
+// Writes values in order to the elements of an array where the mask of the
+// same shape is set, a[mask] = values in NumPy. There has to be one value
+// per set element.
+template<class Tp_>
+inline auto& place(ndarray<Tp_>&        array,
+                   const ndarray<bool>& mask,
+                   const ndarray<Tp_>&  values) {
+    ax_assert(mask.shape() == array.shape(),
+              "Mask does not match shape of array!");
+    if (!array.is_contiguous(stride_type::row_major)) {
+        auto positions = flatnonzero(mask);
+        ax_assert(values.size() == positions.size(),
+                  "Number of values does not match mask!");
+        return put(array, positions, values);
+    }
+
+    const auto m       = mask.as_layout(stride_type::row_major);
+    const auto vals    = values.as_layout(stride_type::row_major);
+    auto       bits    = m.data();
+    auto       src     = vals.data();
+    auto       offsets = detail::mask_offsets(bits, m.size());
+    ax_assert(vals.size() == offsets.back(),
+              "Number of values does not match mask!");
+    auto data = array.data();
+    auto span = trace::span("place", m.size(), m.size() * sizeof(Tp_));
+    span.path(simd::native_compress && simd::vectorizable<Tp_>
+                  ? "simd_expand"
+                  : "scalar");
+    detail::for_mask_blocks(offsets, [&](std::size_t b, std::size_t first,
+                                         std::size_t count) {
+        detail::expand_kernel(data + first, src + offsets[b], bits + first,
+                              count);
+    });
+    return array;
+}
+
+// Sets the elements of an array where the mask is set to value. The mask
+// only has to broadcast to the shape of the array.
+template<class Tp_>
+inline auto& place(ndarray<Tp_>&             array,
+                   const ndarray<bool>&      mask,
+                   std::type_identity_t<Tp_> value) {
+    return array.apply_inplace(
+        [value](const Tp_& x, bool set) { return set ? value : x; }, mask);
+}
+
+// Elements of x where cond is set and of y elsewhere, with all three
+// broadcast against each other. Either of x and y may be a scalar.
+template<class Xt_, class Yt_>
+inline auto where(const ndarray<bool>& cond, Xt_&& x, Yt_&& y) {
+    return detail::make_expression(
+               [](bool set, const auto& lhs, const auto& rhs) {
+                   return set ? lhs : rhs;
+               },
+               cond, std::forward<Xt_>(x), std::forward<Yt_>(y))
+        .eval();
+}
+
+} // namespace ax
+
+#endif /* NDARRAY_SELECT_H_DEFINED */
@@ -0,0 +1,171 @@
+#ifndef NDARRAY_SLICE_H_DEFINED
+#define NDARRAY_SLICE_H_DEFINED
+
+#include "../core.hpp"
+#include "extents.hpp"
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace ax {
+
+// Bound of a range left open, which takes in the axis up to its start or its
+// end depending on the direction of the step.
+inline constexpr std::nullopt_t none = std::nullopt;
+
+namespace detail {
+
+// Positions a range walks along one axis.
+struct slice_axis {
+    std::ptrdiff_t start  = 0;
+    std::ptrdiff_t step   = 1;
+    std::size_t    length = 0;
+};
+
+} // namespace detail
+
+// Positions start, start + step, ... up to but excluding stop along one axis
+// of a slice, as in start:stop:step in Python. Negative bounds count from
+// the end of the axis and bounds past either end are clamped. A negative
+// step walks the axis backwards, from its last position unless a start is
+// given.
+class range {
+ public:
+    // Positions along an axis of length size.
+    constexpr auto resolve(std::size_t size) const {
+        auto n     = static_cast<std::ptrdiff_t>(size);
+        auto lower = step_ > 0 ? std::ptrdiff_t(0) : std::ptrdiff_t(-1);
+        auto upper = step_ > 0 ? n : n - 1;
+        auto clamp = [&](std::optional<std::ptrdiff_t> bound,
+                         std::ptrdiff_t                open) {
+            if (!bound)
+                return open;
+            auto value = *bound < 0 ? *bound + n : *bound;
+            return std::clamp(value, lower, upper);
+        };
+        auto start = clamp(start_, step_ > 0 ? lower : upper);
+        auto stop  = clamp(stop_, step_ > 0 ? upper : lower);
+        auto span  = step_ > 0 ? stop - start : start - stop;
+        auto jump  = step_ > 0 ? step_ : -step_;
+        auto count = span > 0 ? (span - 1) / jump + 1 : 0;
+        return detail::slice_axis {start, step_,
+                                   static_cast<std::size_t>(count)};
+    }
+
+    constexpr range() = default;
+
+    constexpr range(std::optional<std::ptrdiff_t> start,
+                    std::optional<std::ptrdiff_t> stop,
+                    std::ptrdiff_t                step = 1)
+        : start_(start),
+          stop_(stop),
+          step_(step) {
+        ax_assert(step != 0, "Slice step cannot be zero!");
+    }
+
+ private:
+    std::optional<std::ptrdiff_t> start_;
+    std::optional<std::ptrdiff_t> stop_;
+    std::ptrdiff_t                step_ = 1;
+};
+
+// Every position of an axis, : in Python.
+inline constexpr range all {};
+
+struct newaxis_t {
+    explicit constexpr newaxis_t() = default;
+};
+
+struct ellipsis_t {
+    explicit constexpr ellipsis_t() = default;
+};
+
+// Inserts an axis of length one.
+inline constexpr newaxis_t newaxis {};
+
+// Whole axes, as many as the other indices of a slice leave over.
+inline constexpr ellipsis_t ellipsis {};
+
+template<class Tp_>
+concept slice_index
+    = std::integral<Tp_> || std::same_as<Tp_, range>
+   || std::same_as<Tp_, newaxis_t> || std::same_as<Tp_, ellipsis_t>;
+
+namespace detail {
+
+// Position along an axis of the given length, negative indices counting
+// from the end.
+template<std::integral Ix_>
+constexpr auto wrap_index(Ix_ idx, std::size_t length) {
+    auto n = static_cast<std::ptrdiff_t>(length);
+    auto i = static_cast<std::ptrdiff_t>(idx);
+    if constexpr (std::signed_integral<Ix_>)
+        i = i < 0 ? i + n : i;
+    ax_assert(i >= 0 && i < n, "Index out of bounds!");
+    return i;
+}
+
+// Integers and ranges index an axis of the array, the other indices do not.
+template<class Ix_>
+constexpr bool picks_axis = std::integral<Ix_> || std::same_as<Ix_, range>;
+
+// Extents of a slice of an array with the given shape and strides, along
+// with the offset of its first element. Strides are scaled by the steps of
+// the ranges, wrapping around when a step is negative.
+template<slice_index... Ix_>
+constexpr auto slice_extents(const shape_type& shape,
+                             const shape_type& strides,
+                             const Ix_&... idxs) {
+    constexpr auto used = (std::size_t(0) + ... + picks_axis<Ix_>);
+    constexpr auto ellipses
+        = (std::size_t(0) + ... + std::same_as<Ix_, ellipsis_t>);
+    static_assert(ellipses <= 1, "A slice can only have one ellipsis!");
+    auto rank = shape.size();
+    ax_assert(used <= rank, "Too many indices for array!");
+
+    auto           new_shape   = shape_type();
+    auto           new_strides = shape_type();
+    std::ptrdiff_t offset      = 0;
+    std::size_t    axis        = 0;
+    auto           stride      = [&] {
+        return static_cast<std::ptrdiff_t>(strides[axis]);
+    };
+    auto keep = [&](std::size_t extent, std::size_t step) {
+        new_shape.push_back(extent);
+        new_strides.push_back(step);
+    };
+    auto take = [&]<class It_>(const It_& idx) {
+        if constexpr (std::integral<It_>) {
+            offset += wrap_index(idx, shape[axis]) * stride();
+            ++axis;
+        } else if constexpr (std::same_as<It_, range>) {
+            auto positions = idx.resolve(shape[axis]);
+            if (positions.length != 0)
+                offset += positions.start * stride();
+            keep(positions.length,
+                 static_cast<std::size_t>(positions.step * stride()));
+            ++axis;
+        } else if constexpr (std::same_as<It_, newaxis_t>) {
+            keep(1, 0);
+        } else {
+            for (auto count = rank - used; count > 0; --count, ++axis)
+                keep(shape[axis], strides[axis]);
+        }
+    };
+    (take(idxs), ...);
+    for (; axis < rank; ++axis)
+        keep(shape[axis], strides[axis]);
+
+    auto size = ranges::product(new_shape);
+    return std::pair(ndarray_extents<>(new_shape, new_strides, size), offset);
+}
+
+} // namespace detail
+
+} // namespace ax
+
+#endif /* NDARRAY_SLICE_H_DEFINED */
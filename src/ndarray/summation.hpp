@@ -0,0 +1,207 @@
+#ifndef NDARRAY_SUMMATION_H_DEFINED
+#define NDARRAY_SUMMATION_H_DEFINED
+
+#include "../simd/batch.hpp"
+#include "extents.hpp"
+#include "layout.hpp"
+#include "memory.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace ax {
+
+// Accumulation scheme of a full-array sum. Integer sums are exact and always
+// use the fast scheme.
+enum class summation : int {
+    fast,     // Independent SIMD accumulators, error grows linearly with n
+    pairwise, // Pairwise over SIMD base cases, error grows with log n
+    kahan     // Compensated, error independent of n
+};
+
+namespace detail {
+
+// Length below which pairwise summation switches to a flat loop.
+constexpr std::size_t pairwise_base_size = 128;
+
+// A sum with a running compensation term, combined with Neumaier's variant
+// of Kahan's update which also handles addends larger than the sum.
+template<class Tp_>
+struct compensated_sum {
+    Tp_ sum  = 0;
+    Tp_ comp = 0;
+
+    constexpr void add(Tp_ value) noexcept {
+        auto total = sum + value;
+        if (std::abs(sum) >= std::abs(value))
+            comp += (sum - total) + value;
+        else
+            comp += (value - total) + sum;
+        sum = total;
+    }
+
+    constexpr void add(const compensated_sum& other) noexcept {
+        add(other.sum);
+        add(other.comp);
+    }
+
+    constexpr auto value() const noexcept {
+        return sum + comp;
+    }
+};
+
+// Sums count elements spaced stride apart into four independent register
+// accumulators, which hides the latency of the adds.
+template<class Tp_>
+inline Tp_
+multi_sum(const Tp_* const data, std::size_t count, std::ptrdiff_t stride) {
+    auto        n   = static_cast<std::ptrdiff_t>(count);
+    Tp_         sum = 0;
+    std::size_t i   = 0;
+    if constexpr (simd::vectorizable<Tp_>) {
+        using batch = simd::batch<Tp_>;
+        auto w      = static_cast<std::ptrdiff_t>(batch::size);
+        auto acc0   = batch::broadcast(0);
+        auto acc1   = acc0;
+        auto acc2   = acc0;
+        auto acc3   = acc0;
+        auto j      = std::ptrdiff_t(0);
+        for (; j + 4 * w <= n; j += 4 * w) {
+            auto ptr = data + j * stride;
+            acc0     = acc0 + batch::load_strided(ptr, stride);
+            acc1     = acc1 + batch::load_strided(ptr + w * stride, stride);
+            acc2     = acc2 + batch::load_strided(ptr + 2 * w * stride, stride);
+            acc3     = acc3 + batch::load_strided(ptr + 3 * w * stride, stride);
+        }
+        for (; j + w <= n; j += w)
+            acc0 = acc0 + batch::load_strided(data + j * stride, stride);
+        auto acc = (acc0 + acc1) + (acc2 + acc3);
+        for (std::size_t k = 0; k < batch::size; ++k)
+            sum += acc[k];
+        i = static_cast<std::size_t>(j);
+    } else {
+        Tp_ acc[4] = {0, 0, 0, 0};
+        for (; i + 4 <= count; i += 4)
+            for (std::size_t k = 0; k < 4; ++k)
+                acc[k] += data[static_cast<std::ptrdiff_t>(i + k) * stride];
+        sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    }
+    for (; i < count; ++i)
+        sum += data[static_cast<std::ptrdiff_t>(i) * stride];
+    return sum;
+}
+
+template<class Tp_>
+inline Tp_
+pairwise_sum(const Tp_* const data, std::size_t count, std::ptrdiff_t stride) {
+    if (count <= pairwise_base_size)
+        return multi_sum(data, count, stride);
+    // Split on a multiple of 16 to keep the halves register aligned
+    auto half = count / 32 * 16;
+    return pairwise_sum(data, half, stride)
+         + pairwise_sum(data + static_cast<std::ptrdiff_t>(half) * stride,
+                        count - half, stride);
+}
+
+// Kahan summation within each register lane, the lanes are then folded into
+// the running compensated sum.
+template<class Tp_>
+inline void kahan_sum(compensated_sum<Tp_>& result,
+                      const Tp_* const      data,
+                      std::size_t           count,
+                      std::ptrdiff_t        stride) {
+    std::size_t i = 0;
+    if constexpr (simd::vectorizable<Tp_>) {
+        using batch = simd::batch<Tp_>;
+        auto w      = static_cast<std::ptrdiff_t>(batch::size);
+        auto n      = static_cast<std::ptrdiff_t>(count);
+        auto sum    = batch::broadcast(0);
+        auto comp   = sum;
+        auto j      = std::ptrdiff_t(0);
+        for (; j + w <= n; j += w) {
+            auto value = batch::load_strided(data + j * stride, stride) - comp;
+            auto total = sum + value;
+            comp       = (total - sum) - value;
+            sum        = total;
+        }
+        for (std::size_t k = 0; k < batch::size; ++k) {
+            result.add(sum[k]);
+            result.add(-comp[k]);
+        }
+        i = static_cast<std::size_t>(j);
+    }
+    for (; i < count; ++i)
+        result.add(data[static_cast<std::ptrdiff_t>(i) * stride]);
+}
+
+// Sums the elements of an array, see summation for the schemes. Large arrays
+// are summed in fixed blocks across threads and the block sums are combined
+// in order, pairwise unless compensated, so that the result of a given build
+// is reproducible whatever the number of threads. Results can differ between
+// builds for different register widths.
+template<class Tp_>
+inline Tp_ sum_all(const Tp_* const  data,
+                   const shape_type& shape,
+                   const shape_type& strides,
+                   summation         mode) {
+    if constexpr (!std::is_floating_point_v<Tp_>)
+        mode = summation::fast;
+
+    auto count = ranges::product(shape);
+    auto span  = trace::span("sum", count, count * sizeof(Tp_));
+    span.path(mode == summation::kahan      ? "kahan"
+              : mode == summation::pairwise ? "pairwise"
+                                            : "fast");
+
+    auto blocks    = row_blocks(shape, strides);
+    auto stride    = blocks.stride();
+    auto block_sum = [&](std::size_t block) {
+        auto result = compensated_sum<Tp_> {};
+        blocks.visit(data, block, [&](auto ptr, auto count, auto) {
+            if (mode == summation::kahan)
+                kahan_sum(result, ptr, count, stride);
+            else if (mode == summation::pairwise)
+                result.sum += pairwise_sum(ptr, count, stride);
+            else
+                result.sum += multi_sum(ptr, count, stride);
+        });
+        return result;
+    };
+
+    auto nblocks = blocks.size();
+    if (nblocks <= 1)
+        return nblocks ? block_sum(0).value() : Tp_ {};
+
+    auto partials = allocate_buffer<compensated_sum<Tp_>>(nblocks);
+    parallel_for(nblocks, scan_block_size,
+                 [&](std::size_t first, std::size_t last) {
+                     for (auto i = first; i < last; ++i)
+                         partials[i] = block_sum(i);
+                 });
+
+    if (mode == summation::kahan) {
+        for (std::size_t i = 1; i < nblocks; ++i)
+            partials[0].add(partials[i]);
+        return partials[0].value();
+    } else if (mode == summation::pairwise) {
+        for (std::size_t width = 1; width < nblocks; width *= 2)
+            for (std::size_t i = 0; i + width < nblocks; i += 2 * width)
+                partials[i].sum += partials[i + width].sum;
+        return partials[0].sum;
+    }
+    Tp_ result = 0;
+    for (std::size_t i = 0; i < nblocks; ++i)
+        result += partials[i].sum;
+    return result;
+}
+
+} // namespace detail
+
+} // namespace ax
+
+#endif /* NDARRAY_SUMMATION_H_DEFINED */
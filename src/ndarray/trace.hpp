@@ -0,0 +1,296 @@
+#ifndef NDARRAY_TRACE_H_DEFINED
+#define NDARRAY_TRACE_H_DEFINED
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Opt-in instrumentation of the hot paths. Defining AXIOM_TRACE, or
+// configuring with -DAXIOM_TRACE=ON, records the buffer behind every array
+// under the constructor that allocated it and every kernel an operation ran,
+// with the path it took, the elements it covered and its wall time. Without
+// it the hooks are empty and compile away, and the queries below see
+// nothing.
+namespace ax::trace {
+
+#if defined(AXIOM_TRACE)
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+// One run of a kernel. Element-wise kernels count the elements and bytes of
+// their output, reductions those of their input.
+struct event {
+    const char*   op;       // Operation, such as "evaluate"
+    const char*   path;     // Kernel the operation went through
+    std::size_t   elements;
+    std::size_t   bytes;
+    std::uint64_t start;    // Nanoseconds since the first record
+    std::uint64_t duration; // Nanoseconds
+    std::uint32_t thread;
+};
+
+// A buffer allocated for an array.
+struct allocation {
+    const char*   origin; // Constructor, such as "ndarray(shape)"
+    std::size_t   bytes;
+    std::uint64_t time;
+    std::uint32_t thread;
+};
+
+struct kernel_stats {
+    std::string_view op;
+    std::string_view path;
+    std::size_t      calls       = 0;
+    std::size_t      elements    = 0;
+    std::size_t      bytes       = 0;
+    std::uint64_t    nanoseconds = 0;
+};
+
+struct allocation_stats {
+    std::string_view origin;
+    std::size_t      count = 0;
+    std::size_t      bytes = 0;
+};
+
+namespace detail {
+
+// Every record since the last reset(), kept until then.
+class recorder {
+ public:
+    static auto& instance() {
+        static recorder result;
+        return result;
+    }
+
+    auto now() const {
+        auto elapsed = std::chrono::steady_clock::now() - origin_;
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                .count());
+    }
+
+    void add(const event& record) {
+        auto lock = std::scoped_lock(mutex_);
+        events_.push_back(record);
+    }
+
+    void add(const allocation& record) {
+        auto lock = std::scoped_lock(mutex_);
+        allocations_.push_back(record);
+    }
+
+    auto events() const {
+        auto lock = std::scoped_lock(mutex_);
+        return events_;
+    }
+
+    auto allocations() const {
+        auto lock = std::scoped_lock(mutex_);
+        return allocations_;
+    }
+
+    void clear() {
+        auto lock = std::scoped_lock(mutex_);
+        events_.clear();
+        allocations_.clear();
+    }
+
+ private:
+    std::chrono::steady_clock::time_point origin_
+        = std::chrono::steady_clock::now();
+    mutable std::mutex      mutex_;
+    std::vector<event>      events_;
+    std::vector<allocation> allocations_;
+};
+
+// Small number naming the calling thread, in order of first record.
+inline std::uint32_t thread_index() {
+    static std::atomic<std::uint32_t> next = 0;
+    thread_local auto                 index = next++;
+    return index;
+}
+
+} // namespace detail
+
+// Records a buffer of the given size allocated by the named constructor.
+inline void record_allocation([[maybe_unused]] const char* origin,
+                              [[maybe_unused]] std::size_t bytes) {
+    if constexpr (enabled) {
+        auto& recorder = detail::recorder::instance();
+        recorder.add(allocation {origin, bytes, recorder.now(),
+                                 detail::thread_index()});
+    }
+}
+
+#if defined(AXIOM_TRACE)
+
+// Times an operation from construction to destruction and records it with
+// the kernel path set once the operation has picked one.
+class span {
+ public:
+    span(const char* op, std::size_t elements, std::size_t bytes)
+        : op_(op),
+          elements_(elements),
+          bytes_(bytes),
+          start_(detail::recorder::instance().now()) {
+    }
+
+    span(const span&) = delete;
+
+    span& operator=(const span&) = delete;
+
+    ~span() {
+        auto& recorder = detail::recorder::instance();
+        recorder.add(event {op_, path_, elements_, bytes_, start_,
+                            recorder.now() - start_, detail::thread_index()});
+    }
+
+    void path(const char* name) noexcept {
+        path_ = name;
+    }
+
+ private:
+    const char*   op_;
+    const char*   path_ = "";
+    std::size_t   elements_;
+    std::size_t   bytes_;
+    std::uint64_t start_;
+};
+
+#else
+
+class span {
+ public:
+    constexpr span(const char*, std::size_t, std::size_t) noexcept {
+    }
+
+    span(const span&) = delete;
+
+    span& operator=(const span&) = delete;
+
+    constexpr void path(const char*) noexcept {
+    }
+};
+
+#endif
+
+// Records of every kernel run and allocation since the last reset().
+inline auto events() {
+    return detail::recorder::instance().events();
+}
+
+inline auto allocations() {
+    return detail::recorder::instance().allocations();
+}
+
+inline void reset() {
+    detail::recorder::instance().clear();
+}
+
+// Kernel runs totalled per operation and path, sorted by both.
+inline auto kernel_summary() {
+    auto totals = std::map<std::pair<std::string_view, std::string_view>,
+                           kernel_stats>();
+    for (auto& record : events()) {
+        auto& stats = totals[{record.op, record.path}];
+        stats.op    = record.op;
+        stats.path  = record.path;
+        stats.calls++;
+        stats.elements    += record.elements;
+        stats.bytes       += record.bytes;
+        stats.nanoseconds += record.duration;
+    }
+    auto result = std::vector<kernel_stats>();
+    for (auto& [key, stats] : totals)
+        result.push_back(stats);
+    return result;
+}
+
+// Allocations totalled per constructor, sorted by its name.
+inline auto allocation_summary() {
+    auto totals = std::map<std::string_view, allocation_stats>();
+    for (auto& record : allocations()) {
+        auto& stats  = totals[record.origin];
+        stats.origin = record.origin;
+        stats.count++;
+        stats.bytes += record.bytes;
+    }
+    auto result = std::vector<allocation_stats>();
+    for (auto& [key, stats] : totals)
+        result.push_back(stats);
+    return result;
+}
+
+// Writes both summaries as tables.
+inline void write_summary(std::ostream& os) {
+    auto flags     = os.flags();
+    auto precision = os.precision();
+    os << std::left << std::setw(20) << "operation" << std::setw(24) << "path"
+       << std::right << std::setw(8) << "calls" << std::setw(14) << "elements"
+       << std::setw(14) << "bytes" << std::setw(12) << "ms" << '\n';
+    for (auto& stats : kernel_summary())
+        os << std::left << std::setw(20) << stats.op << std::setw(24)
+           << stats.path << std::right << std::setw(8) << stats.calls
+           << std::setw(14) << stats.elements << std::setw(14) << stats.bytes
+           << std::setw(12) << std::fixed << std::setprecision(3)
+           << static_cast<double>(stats.nanoseconds) * 1e-6 << '\n';
+    os << '\n'
+       << std::left << std::setw(44) << "allocated by" << std::right
+       << std::setw(8) << "count" << std::setw(14) << "bytes" << '\n';
+    for (auto& stats : allocation_summary())
+        os << std::left << std::setw(44) << stats.origin << std::right
+           << std::setw(8) << stats.count << std::setw(14) << stats.bytes
+           << '\n';
+    os.flags(flags);
+    os.precision(precision);
+}
+
+// Writes every record in the Trace Event Format, for chrome://tracing or
+// Perfetto. Kernels are complete events named by operation and categorized
+// by path, allocations are instant events.
+inline void write_chrome_trace(std::ostream& os) {
+    auto flags     = os.flags();
+    auto precision = os.precision();
+    auto us        = [](std::uint64_t ns) {
+        return static_cast<double>(ns) * 1e-3;
+    };
+    auto first = true;
+    auto next  = [&] {
+        os << (first ? "\n" : ",\n");
+        first = false;
+    };
+    os << "{\"traceEvents\":[" << std::fixed << std::setprecision(3);
+    for (auto& record : events()) {
+        next();
+        os << "{\"name\":\"" << record.op << "\",\"cat\":\"" << record.path
+           << "\",\"ph\":\"X\",\"ts\":" << us(record.start)
+           << ",\"dur\":" << us(record.duration)
+           << ",\"pid\":0,\"tid\":" << record.thread
+           << ",\"args\":{\"elements\":" << record.elements
+           << ",\"bytes\":" << record.bytes << "}}";
+    }
+    for (auto& record : allocations()) {
+        next();
+        os << "{\"name\":\"" << record.origin
+           << "\",\"cat\":\"allocation\",\"ph\":\"i\",\"s\":\"t\",\"ts\":"
+           << us(record.time) << ",\"pid\":0,\"tid\":" << record.thread
+           << ",\"args\":{\"bytes\":" << record.bytes << "}}";
+    }
+    os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    os.flags(flags);
+    os.precision(precision);
+}
+
+} // namespace ax::trace
+
+#endif /* NDARRAY_TRACE_H_DEFINED */
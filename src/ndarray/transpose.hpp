@@ -0,0 +1,274 @@
+#ifndef NDARRAY_TRANSPOSE_H_DEFINED
+#define NDARRAY_TRANSPOSE_H_DEFINED
+
+#include "../core.hpp"
+#include "../simd/transpose.hpp"
+#include "concepts.hpp"
+#include "expression.hpp"
+#include "extents.hpp"
+#include "layout.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace ax {
+
+namespace detail {
+
+// Edge of the blocks at which the recursive transposes stop splitting, a
+// block and its transpose fit in the L1 cache together.
+template<class Tp_>
+constexpr std::ptrdiff_t transpose_block = sizeof(Tp_) <= 4 ? 64 : 32;
+
+// Rows of the blocks are split at multiples of the register tiles.
+template<class Tp_>
+constexpr std::ptrdiff_t transpose_tile = [] {
+    if constexpr (simd::tile_transposable<Tp_>)
+        return static_cast<std::ptrdiff_t>(simd::tile_size<Tp_>);
+    else
+        return std::ptrdiff_t(1);
+}();
+
+// Writes the transpose of the rows x cols matrix at src, with rows sld
+// elements apart, to dst with rows dld elements apart: dst[j, i] = src[i, j].
+// Whole tiles are transposed in registers, the edges one element at a time.
+// Leading dimensions are signed as either matrix may be a reversed view.
+template<class Tp_>
+inline void transpose_kernel(const Tp_* const src,
+                             std::ptrdiff_t   sld,
+                             Tp_* const       dst,
+                             std::ptrdiff_t   dld,
+                             std::ptrdiff_t   rows,
+                             std::ptrdiff_t   cols) {
+    std::ptrdiff_t i = 0;
+    if constexpr (simd::tile_transposable<Tp_>) {
+        constexpr auto n = transpose_tile<Tp_>;
+        for (; i + n <= rows; i += n) {
+            std::ptrdiff_t j = 0;
+            for (; j + n <= cols; j += n)
+                simd::transpose_tile(src + i * sld + j, sld, dst + j * dld + i,
+                                     dld);
+            for (; j < cols; ++j)
+                for (auto k = i; k < i + n; ++k)
+                    dst[j * dld + k] = src[k * sld + j];
+        }
+    }
+    for (; i < rows; ++i)
+        for (std::ptrdiff_t j = 0; j < cols; ++j)
+            dst[j * dld + i] = src[i * sld + j];
+}
+
+// Cache-oblivious out-of-place transpose: the longer side is halved until
+// the blocks fit in the cache, whatever its size.
+template<class Tp_>
+inline void transpose_copy(const Tp_* const src,
+                           std::ptrdiff_t   sld,
+                           Tp_* const       dst,
+                           std::ptrdiff_t   dld,
+                           std::ptrdiff_t   rows,
+                           std::ptrdiff_t   cols) {
+    constexpr auto block = transpose_block<Tp_>;
+    constexpr auto tile  = transpose_tile<Tp_>;
+    if (rows <= block && cols <= block) {
+        transpose_kernel(src, sld, dst, dld, rows, cols);
+    } else if (rows >= cols) {
+        auto half = rows / 2 / tile * tile;
+        transpose_copy(src, sld, dst, dld, half, cols);
+        transpose_copy(src + half * sld, sld, dst + half, dld, rows - half,
+                       cols);
+    } else {
+        auto half = cols / 2 / tile * tile;
+        transpose_copy(src, sld, dst, dld, rows, half);
+        transpose_copy(src + half, sld, dst + half * dld, dld, rows,
+                       cols - half);
+    }
+}
+
+// Swaps the rows x cols block of a square matrix at (r0, c0) with its mirror
+// at (c0, r0), transposing both. A block on the diagonal is transposed onto
+// itself.
+template<class Tp_>
+inline void swap_transpose_block(Tp_* const     data,
+                                 std::ptrdiff_t ld,
+                                 std::ptrdiff_t r0,
+                                 std::ptrdiff_t c0,
+                                 std::ptrdiff_t rows,
+                                 std::ptrdiff_t cols) {
+    auto diagonal = r0 == c0;
+    auto swap     = [&](std::ptrdiff_t r, std::ptrdiff_t c) {
+        std::swap(data[(r0 + r) * ld + c0 + c], data[(c0 + c) * ld + r0 + r]);
+    };
+
+    std::ptrdiff_t i = 0;
+    if constexpr (simd::tile_transposable<Tp_>) {
+        constexpr auto n = transpose_tile<Tp_>;
+        for (; i + n <= rows; i += n) {
+            auto j = diagonal ? i : 0;
+            for (; j + n <= cols; j += n) {
+                auto lhs = data + (r0 + i) * ld + c0 + j;
+                auto rhs = data + (c0 + j) * ld + r0 + i;
+                if (lhs == rhs)
+                    simd::transpose_tile(lhs, ld, lhs, ld);
+                else
+                    simd::swap_transpose_tiles(lhs, rhs, ld);
+            }
+            for (auto r = i; r < i + n; ++r)
+                for (auto c = j; c < cols; ++c)
+                    swap(r, c);
+        }
+    }
+    for (; i < rows; ++i)
+        for (auto c = diagonal ? i + 1 : 0; c < cols; ++c)
+            swap(i, c);
+}
+
+// Transposes the n x n matrix at data, with rows ld elements apart, in
+// place. The blocks above the diagonal are swapped with those below it and
+// the pairs are split across threads.
+template<class Tp_>
+inline void
+transpose_square(Tp_* const data, std::ptrdiff_t n, std::ptrdiff_t ld) {
+    constexpr auto block = transpose_block<Tp_>;
+    auto pairs = std::vector<std::pair<std::ptrdiff_t, std::ptrdiff_t>>();
+    for (std::ptrdiff_t r = 0; r < n; r += block)
+        for (auto c = r; c < n; c += block)
+            pairs.emplace_back(r, c);
+    parallel_for(pairs.size(), block * block,
+                 [&](std::size_t first, std::size_t last) {
+                     for (auto k = first; k < last; ++k) {
+                         auto [r, c] = pairs[k];
+                         swap_transpose_block(data, ld, r, c,
+                                              std::min(block, n - r),
+                                              std::min(block, n - c));
+                     }
+                 });
+}
+
+// Copies src into dest of the same shape. A source that is contiguous
+// along an axis other than the innermost axis of the walk over dest, such
+// as a view with permuted axes, is copied plane by plane with blocked
+// transposes of those two axes. Anything else is evaluated element-wise.
+template<class Tp_>
+inline void materialize(const ndarray<Tp_>& dest, const ndarray<Tp_>& src) {
+    ax_assert(dest.shape() == src.shape(),
+              "Cannot copy array into array of different shape!");
+    auto nest  = loop_nest(dest.shape(),
+                           std::array {dest.strides(), src.strides()});
+    auto ds    = nest.strides(dest.strides());
+    auto ss    = nest.strides(src.strides());
+    auto inner = nest.rank() - 1;
+    auto axis  = static_cast<std::size_t>(std::ranges::find(ss, 1)
+                                         - ss.begin());
+    auto span  = trace::span("materialize", dest.size(),
+                             dest.size() * sizeof(Tp_));
+    if (dest.size() == 0 || ds[inner] != 1 || axis >= inner) {
+        span.path("elementwise");
+        evaluate(dest, make_expression(std::identity(), src));
+        return;
+    }
+
+    // The planes of the two axes are walked along the remaining axes
+    auto oshape   = shape_type();
+    auto ostrides = std::array {shape_type(), shape_type()};
+    for (std::size_t i = 0; auto extent : nest.shape()) {
+        if (i != axis && i != inner) {
+            oshape.push_back(extent);
+            ostrides[0].push_back(ds[i]);
+            ostrides[1].push_back(ss[i]);
+        }
+        ++i;
+    }
+    oshape.push_back(1);
+    ostrides[0].push_back(0);
+    ostrides[1].push_back(0);
+
+    auto dst   = dest.data();
+    auto data  = src.data();
+    auto sld   = static_cast<std::ptrdiff_t>(ss[inner]);
+    auto dld   = static_cast<std::ptrdiff_t>(ds[axis]);
+    auto rows  = nest.shape()[inner];
+    auto cols  = static_cast<std::ptrdiff_t>(nest.shape()[axis]);
+    auto count = ranges::product(oshape);
+    if (count >= get_num_threads()) {
+        span.path("transpose_planes");
+        auto copy = [&](const auto&, const auto& offsets) {
+            transpose_copy(data + offsets[1], sld, dst + offsets[0], dld,
+                           static_cast<std::ptrdiff_t>(rows), cols);
+        };
+        parallel_for(count, rows * nest.shape()[axis],
+                     [&](std::size_t first, std::size_t last) {
+                         walk_rows(oshape, ostrides, first, last, copy);
+                     });
+        return;
+    }
+
+    // Few large planes are split into stripes of rows across threads
+    span.path("transpose_stripes");
+    auto copy = [&](const auto&, const auto& offsets) {
+        parallel_for(
+            rows, nest.shape()[axis],
+            [&](std::size_t first, std::size_t last) {
+                auto i = static_cast<std::ptrdiff_t>(first);
+                transpose_copy(data + offsets[1] + i * sld, sld,
+                               dst + offsets[0] + i, dld,
+                               static_cast<std::ptrdiff_t>(last - first),
+                               cols);
+            },
+            line_grain<Tp_>);
+    };
+    walk_rows(oshape, ostrides, 0, count, copy);
+}
+
+} // namespace detail
+
+// Transposes the last two axes of an array in place, which have to be of
+// the same length. Unlike transpose() the elements move rather than the
+// strides, so the array keeps its layout.
+template<class Tp_>
+inline auto& transpose_inplace(ndarray<Tp_>& array) {
+    ax_assert(array.rank() >= 2, "Cannot transpose array less than rank 2!");
+    auto  rank    = array.rank();
+    auto& shape   = array.shape();
+    auto& strides = array.strides();
+    auto  n       = shape[rank - 1];
+    ax_assert(shape[rank - 2] == n,
+              "Cannot transpose non-square matrices in place!");
+
+    auto data    = array.data();
+    auto rs      = static_cast<std::ptrdiff_t>(strides[rank - 2]);
+    auto cs      = static_cast<std::ptrdiff_t>(strides[rank - 1]);
+    auto span    = trace::span("transpose_inplace", array.size(),
+                               array.size() * sizeof(Tp_));
+    span.path(rs == 1 || cs == 1 ? "blocked" : "element_swaps");
+    auto mshape  = shape_type(shape.begin(), shape.end() - 1);
+    auto mstride = std::array {shape_type(strides.begin(), strides.end() - 1)};
+    mshape.back()     = 1;
+    mstride[0].back() = 0;
+    auto transpose    = [&](const auto&, const auto& offsets) {
+        auto matrix = data + offsets[0];
+        auto size   = static_cast<std::ptrdiff_t>(n);
+        if (rs == 1 || cs == 1) {
+            detail::transpose_square(matrix, size, rs == 1 ? cs : rs);
+            return;
+        }
+        for (std::ptrdiff_t i = 0; i < size; ++i)
+            for (auto j = i + 1; j < size; ++j)
+                std::swap(matrix[i * rs + j * cs], matrix[j * rs + i * cs]);
+    };
+    // A single matrix is split across threads by transpose_square instead
+    detail::parallel_for(ranges::product(mshape), n * n,
+                         [&](std::size_t first, std::size_t last) {
+                             detail::walk_rows(mshape, mstride, first, last,
+                                               transpose);
+                         });
+    return array;
+}
+
+} // namespace ax
+
+#endif /* NDARRAY_TRANSPOSE_H_DEFINED */
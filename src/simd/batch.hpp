@@ -0,0 +1,285 @@
+#ifndef SIMD_BATCH_H_DEFINED
+#define SIMD_BATCH_H_DEFINED
+
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace ax::simd {
+
+#if defined(__AVX512F__)
+constexpr std::size_t register_bytes = 64;
+#elif defined(__AVX__)
+constexpr std::size_t register_bytes = 32;
+#else
+constexpr std::size_t register_bytes = 16;
+#endif
+
+template<class Tp_>
+concept vectorizable
+    = std::same_as<Tp_, float> || std::same_as<Tp_, double>
+   || std::same_as<Tp_, std::int32_t> || std::same_as<Tp_, std::int64_t>;
+
+// Number of elements to process one at a time before ptr is aligned to a
+// full register.
+template<class Tp_>
+inline auto alignment_offset(const Tp_* ptr) noexcept {
+    auto addr = reinterpret_cast<std::uintptr_t>(ptr);
+    return ((register_bytes - addr % register_bytes) % register_bytes)
+         / sizeof(Tp_);
+}
+
+// A full register of elements built on the GCC/Clang vector extensions so
+// that the same code lowers to SSE, AVX or AVX-512 depending on -march.
+template<vectorizable Tp_>
+class batch {
+ public:
+    using value_type = Tp_;
+
+    using native_type [[gnu::vector_size(register_bytes)]] = Tp_;
+
+    // Integer vector of the same lane width, as produced by comparisons.
+    using mask_type = decltype(native_type {} < native_type {});
+
+    static constexpr std::size_t size = register_bytes / sizeof(Tp_);
+
+    // Subtracting zero rather than adding it keeps the sign of -0.0.
+    static auto broadcast(Tp_ value) noexcept {
+        return batch(value - native_type {});
+    }
+
+    static auto load(const Tp_* ptr) noexcept {
+        native_type value;
+        std::memcpy(&value, ptr, sizeof(native_type));
+        return batch(value);
+    }
+
+    static auto load_aligned(const Tp_* ptr) noexcept {
+        return batch(*reinterpret_cast<const native_type*>(ptr));
+    }
+
+    static auto gather(const Tp_* ptr, std::ptrdiff_t stride) noexcept {
+#if defined(__AVX2__) && !defined(__AVX512F__)
+        if (stride > 0 && stride <= std::numeric_limits<int>::max() / 8) {
+            auto s = static_cast<int>(stride);
+            if constexpr (std::same_as<Tp_, double>) {
+                auto idx = _mm_setr_epi32(0, s, 2 * s, 3 * s);
+                return batch(std::bit_cast<native_type>(
+                    _mm256_i32gather_pd(ptr, idx, 8)));
+            } else if constexpr (std::same_as<Tp_, std::int64_t>) {
+                auto idx = _mm_setr_epi32(0, s, 2 * s, 3 * s);
+                return batch(std::bit_cast<native_type>(_mm256_i32gather_epi64(
+                    reinterpret_cast<const long long*>(ptr), idx, 8)));
+            } else {
+                auto idx = _mm256_mullo_epi32(
+                    _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                    _mm256_set1_epi32(s));
+                if constexpr (std::same_as<Tp_, float>)
+                    return batch(std::bit_cast<native_type>(
+                        _mm256_i32gather_ps(ptr, idx, 4)));
+                else
+                    return batch(std::bit_cast<native_type>(
+                        _mm256_i32gather_epi32(
+                            reinterpret_cast<const int*>(ptr), idx, 4)));
+            }
+        }
+#endif
+        native_type value;
+        for (std::size_t i = 0; i < size; ++i)
+            value[i] = ptr[static_cast<std::ptrdiff_t>(i) * stride];
+        return batch(value);
+    }
+
+    // Loads size elements spaced stride apart. A stride of zero repeats a
+    // broadcast element and a stride of one is a plain contiguous load.
+    static auto load_strided(const Tp_* ptr, std::ptrdiff_t stride) noexcept {
+        if (stride == 1)
+            return load(ptr);
+        else if (stride == 0)
+            return broadcast(*ptr);
+        return gather(ptr, stride);
+    }
+
+    void store(Tp_* ptr) const noexcept {
+        std::memcpy(ptr, &value_, sizeof(native_type));
+    }
+
+    void store_aligned(Tp_* ptr) const noexcept {
+        *reinterpret_cast<native_type*>(ptr) = value_;
+    }
+
+    auto operator[](std::size_t idx) const noexcept {
+        return value_[idx];
+    }
+
+    auto& native() const noexcept {
+        return value_;
+    }
+
+    batch() = default;
+
+    explicit batch(native_type value) noexcept
+        : value_(value) {
+    }
+
+    friend auto operator+(const batch& lhs, const batch& rhs) noexcept {
+        return batch(lhs.value_ + rhs.value_);
+    }
+
+    friend auto operator-(const batch& lhs, const batch& rhs) noexcept {
+        return batch(lhs.value_ - rhs.value_);
+    }
+
+    friend auto operator*(const batch& lhs, const batch& rhs) noexcept {
+        return batch(lhs.value_ * rhs.value_);
+    }
+
+    friend auto operator/(const batch& lhs, const batch& rhs) noexcept {
+        return batch(lhs.value_ / rhs.value_);
+    }
+
+    friend auto operator-(const batch& arg) noexcept {
+        return batch(-arg.value_);
+    }
+
+    // Lane-wise minimum and maximum. Lanes where rhs is NaN keep the lane of
+    // lhs, so NaN never enters an accumulator passed as lhs.
+    friend auto min(const batch& lhs, const batch& rhs) noexcept {
+        return batch(rhs.value_ < lhs.value_ ? rhs.value_ : lhs.value_);
+    }
+
+    friend auto max(const batch& lhs, const batch& rhs) noexcept {
+        return batch(rhs.value_ > lhs.value_ ? rhs.value_ : lhs.value_);
+    }
+
+    // Lane mask of NaN elements, all lanes set to -1 or 0.
+    friend auto isnan(const batch& arg) noexcept {
+        return arg.value_ != arg.value_;
+    }
+
+ private:
+    native_type value_;
+};
+
+template<class>
+struct is_batch : std::false_type {};
+
+template<class Tp_>
+struct is_batch<batch<Tp_>> : std::true_type {};
+
+template<class Tp_>
+constexpr auto is_batch_v = is_batch<Tp_>::value;
+
+// Applies a functor to batches. The typed standard functors only accept
+// scalars so they are mapped onto the batch operators, anything else that
+// is callable with batches (transparent functors, vectorized lambdas) is
+// called directly.
+template<class Tp_, class Bt_>
+constexpr auto invoke(const std::plus<Tp_>&, const Bt_& lhs, const Bt_& rhs) {
+    return lhs + rhs;
+}
+
+template<class Tp_, class Bt_>
+constexpr auto invoke(const std::minus<Tp_>&, const Bt_& lhs, const Bt_& rhs) {
+    return lhs - rhs;
+}
+
+template<class Tp_, class Bt_>
+constexpr auto
+invoke(const std::multiplies<Tp_>&, const Bt_& lhs, const Bt_& rhs) {
+    return lhs * rhs;
+}
+
+template<class Tp_, class Bt_>
+constexpr auto
+invoke(const std::divides<Tp_>&, const Bt_& lhs, const Bt_& rhs) {
+    return lhs / rhs;
+}
+
+template<class Tp_, class Bt_>
+constexpr auto invoke(const std::negate<Tp_>&, const Bt_& arg) {
+    return -arg;
+}
+
+template<class Fn_, class... Bts_>
+    requires(std::invocable<const Fn_&, const Bts_&...>)
+constexpr auto invoke(const Fn_& func, const Bts_&... args) {
+    return func(args...);
+}
+
+// Functors opt into running on batches through is_vectorized: the standard
+// arithmetic functors, std::identity and anything wrapped by vectorize().
+// Other callables only ever see scalars, as calling a generic lambda on
+// batches to find out whether it can be instantiates its body, and a body
+// that does not compile for batches would then be a hard error.
+template<class Fn_>
+struct is_vectorized : std::false_type {};
+
+template<class Tp_>
+struct is_vectorized<std::plus<Tp_>> : std::true_type {};
+
+template<class Tp_>
+struct is_vectorized<std::minus<Tp_>> : std::true_type {};
+
+template<class Tp_>
+struct is_vectorized<std::multiplies<Tp_>> : std::true_type {};
+
+template<class Tp_>
+struct is_vectorized<std::divides<Tp_>> : std::true_type {};
+
+template<class Tp_>
+struct is_vectorized<std::negate<Tp_>> : std::true_type {};
+
+template<>
+struct is_vectorized<std::identity> : std::true_type {};
+
+// A functor whose body works on scalars and batches alike, such as
+// [](const auto& x) { return x * x + x; }, and may be run on either.
+template<class Fn_>
+struct vectorized {
+    Fn_ func;
+
+    template<class... Tps_>
+        requires(std::invocable<const Fn_&, const Tps_&...>)
+    constexpr auto operator()(const Tps_&... args) const {
+        return func(args...);
+    }
+};
+
+template<class Fn_>
+struct is_vectorized<vectorized<Fn_>> : std::true_type {};
+
+template<class Fn_>
+constexpr auto vectorize(Fn_&& func) {
+    return vectorized<std::remove_cvref_t<Fn_>> {std::forward<Fn_>(func)};
+}
+
+template<class Fn_>
+constexpr auto is_vectorized_v = is_vectorized<std::remove_cvref_t<Fn_>>::value;
+
+// A functor can be run on registers of Tp_ when it opted in and invoking it
+// on batches yields a batch of the same type.
+template<class Fn_, class Tp_, std::size_t Arity_>
+concept vectorizable_op
+    = vectorizable<Tp_> && is_vectorized_v<Fn_>
+   && ((Arity_ == 1
+        && requires(const Fn_& func, const batch<Tp_>& arg) {
+               { simd::invoke(func, arg) } -> std::same_as<batch<Tp_>>;
+           })
+       || (Arity_ == 2
+           && requires(const Fn_& func, const batch<Tp_>& arg) {
+                  { simd::invoke(func, arg, arg) } -> std::same_as<batch<Tp_>>;
+              }));
+
+} // namespace ax::simd
+
+#endif /* SIMD_BATCH_H_DEFINED */
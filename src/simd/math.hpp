@@ -0,0 +1,672 @@
+#ifndef SIMD_MATH_H_DEFINED
+#define SIMD_MATH_H_DEFINED
+
+#include "batch.hpp"
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Elementary functions on batches of float and double. Each one reduces its
+// argument to a short interval, evaluates a polynomial there and undoes the
+// reduction with bit manipulation, so that a whole register is computed
+// without branches. Errors are in ulp of the result, measured against long
+// double libm over random arguments. Scalar overloads run the same kernel
+// on one lane so that the heads and tails of a loop agree with its body,
+// other arithmetic types go to the standard library.
+
+namespace ax::simd {
+
+namespace detail {
+
+template<class Tp_>
+using native = typename batch<Tp_>::native_type;
+
+// Integer lanes of the same width as Tp_.
+template<class Tp_>
+using integer = typename batch<Tp_>::mask_type;
+
+template<class Tp_>
+using lane = std::remove_cvref_t<decltype(integer<Tp_> {}[0])>;
+
+template<class Tp_>
+constexpr int mantissa_bits = std::numeric_limits<Tp_>::digits - 1;
+
+template<class Tp_>
+constexpr int exponent_bias = std::numeric_limits<Tp_>::max_exponent - 1;
+
+template<class Tp_>
+constexpr auto sign_mask = lane<Tp_>(1) << (sizeof(Tp_) * 8 - 1);
+
+template<class Tp_>
+inline auto splat(Tp_ value) noexcept {
+    return batch<Tp_>::broadcast(value).native();
+}
+
+template<class Mt_>
+inline auto any(const Mt_& mask) noexcept {
+    using words = std::array<std::uint64_t, sizeof(Mt_) / 8>;
+    auto bits   = std::uint64_t(0);
+    for (auto word : std::bit_cast<words>(mask))
+        bits |= word;
+    return bits != 0;
+}
+
+template<class Tp_>
+inline auto abs(const native<Tp_>& x) noexcept {
+    return std::bit_cast<native<Tp_>>(std::bit_cast<integer<Tp_>>(x)
+                                      & ~sign_mask<Tp_>);
+}
+
+// Magnitude of x with the sign bit of sign.
+template<class Tp_>
+inline auto copysign(const native<Tp_>& x, const native<Tp_>& sign) noexcept {
+    return std::bit_cast<native<Tp_>>(
+        std::bit_cast<integer<Tp_>>(abs<Tp_>(x))
+        | (std::bit_cast<integer<Tp_>>(sign) & sign_mask<Tp_>));
+}
+
+// Horner's scheme with the coefficients from the highest degree down.
+template<class Vt_, class Cs_>
+inline auto polynomial(const Vt_& x, const Cs_& coefs) noexcept {
+    auto result = Vt_ {} + coefs[0];
+    for (std::size_t i = 1; i < std::size(coefs); ++i)
+        result = result * x + coefs[i];
+    return result;
+}
+
+// a * b + c rounded once with a fused multiply-add where there is one. The
+// fallback splits a and b in halves whose products are exact (Dekker), so
+// that only the two sums are rounded.
+template<class Tp_>
+inline auto
+fma(const native<Tp_>& a, const native<Tp_>& b, const native<Tp_>& c) noexcept {
+#if defined(__AVX512F__)
+    if constexpr (std::same_as<Tp_, double>)
+        return std::bit_cast<native<Tp_>>(_mm512_fmadd_pd(
+            std::bit_cast<__m512d>(a), std::bit_cast<__m512d>(b),
+            std::bit_cast<__m512d>(c)));
+    else
+        return std::bit_cast<native<Tp_>>(_mm512_fmadd_ps(
+            std::bit_cast<__m512>(a), std::bit_cast<__m512>(b),
+            std::bit_cast<__m512>(c)));
+#elif defined(__FMA__)
+    if constexpr (std::same_as<Tp_, double>)
+        return std::bit_cast<native<Tp_>>(_mm256_fmadd_pd(
+            std::bit_cast<__m256d>(a), std::bit_cast<__m256d>(b),
+            std::bit_cast<__m256d>(c)));
+    else
+        return std::bit_cast<native<Tp_>>(_mm256_fmadd_ps(
+            std::bit_cast<__m256>(a), std::bit_cast<__m256>(b),
+            std::bit_cast<__m256>(c)));
+#else
+    constexpr auto split  = Tp_((1 << (mantissa_bits<Tp_> + 2) / 2) + 1);
+    auto           halves = [](const native<Tp_>& x) {
+        auto scaled = x * split;
+        auto high   = scaled - (scaled - x);
+        return std::pair(high, x - high);
+    };
+    auto [ah, al] = halves(a);
+    auto [bh, bl] = halves(b);
+    auto hi       = a * b;
+    auto lo       = ((ah * bh - hi) + ah * bl + al * bh) + al * bl;
+    return (hi + c) + lo;
+#endif
+}
+
+// Product of a and b as an unevaluated sum hi + lo that is exact.
+template<class Tp_>
+inline auto two_product(const native<Tp_>& a, const native<Tp_>& b) noexcept {
+    auto hi = a * b;
+    return std::pair(hi, fma<Tp_>(a, b, -hi));
+}
+
+// Sum of a and b as an unevaluated sum hi + lo that is exact.
+template<class Tp_>
+inline auto two_sum(const native<Tp_>& a, const native<Tp_>& b) noexcept {
+    auto hi = a + b;
+    auto bb = hi - a;
+    return std::pair(hi, (a - (hi - bb)) + (b - bb));
+}
+
+// Rounds x to the nearest integer, as floating point and as integer lanes,
+// by adding and subtracting 1.5 * 2^mantissa_bits. Valid for |x| below
+// 2^(mantissa_bits - 1).
+template<class Tp_>
+inline auto round_parts(const native<Tp_>& x) noexcept {
+    constexpr auto shifter = Tp_(lane<Tp_>(3) << (mantissa_bits<Tp_> - 1));
+    auto           shifted = x + shifter;
+    auto n = std::bit_cast<integer<Tp_>>(shifted)
+           - std::bit_cast<integer<Tp_>>(splat(shifter));
+    return std::pair(shifted - shifter, n);
+}
+
+// 2^n for n within the range of normal exponents.
+template<class Tp_>
+inline auto exp2i(const integer<Tp_>& n) noexcept {
+    return std::bit_cast<native<Tp_>>((n + exponent_bias<Tp_>)
+                                      << mantissa_bits<Tp_>);
+}
+
+// x * 2^n in two steps, so that the result may be subnormal or overflow
+// while each factor stays normal.
+template<class Tp_>
+inline auto scale(const native<Tp_>& x, const integer<Tp_>& n) noexcept {
+    auto half = n >> 1;
+    return x * exp2i<Tp_>(half) * exp2i<Tp_>(n - half);
+}
+
+// ln(2) split so that its high part times an exponent is exact.
+template<class Tp_>
+constexpr Tp_ ln2_hi = std::same_as<Tp_, double> ? 6.93147180369123816490e-01
+                                                 : 6.9314575195e-01f;
+
+template<class Tp_>
+constexpr Tp_ ln2_lo = std::same_as<Tp_, double> ? 1.90821492927058770002e-10
+                                                 : 1.4286067653e-06f;
+
+// exp(x + lo) for a correction lo much smaller than x. With n the nearest
+// integer to x / ln(2), exp(r) for r = x - n ln(2) in [-ln(2)/2, ln(2)/2]
+// is a polynomial and the result is exp(r) 2^n.
+template<class Tp_>
+inline auto exp_kernel(native<Tp_>        x,
+                       const native<Tp_>& lo = native<Tp_> {}) noexcept {
+    // Saturate far enough out that the result is 0 or infinity
+    constexpr auto min = std::same_as<Tp_, double> ? Tp_(-746) : Tp_(-104);
+    constexpr auto max = std::same_as<Tp_, double> ? Tp_(710) : Tp_(89);
+    x = x < min ? splat(min) : x;
+    x = x > max ? splat(max) : x;
+
+    auto [nf, n] = round_parts<Tp_>(x * std::numbers::log2e_v<Tp_>);
+    auto r       = x - nf * ln2_hi<Tp_> - nf * ln2_lo<Tp_> + lo;
+    auto p       = native<Tp_> {};
+    if constexpr (std::same_as<Tp_, double>) {
+        // Taylor series up to r^13 / 13!
+        static constexpr double coefs[] = {
+            1.0 / 6227020800, 1.0 / 479001600, 1.0 / 39916800,
+            1.0 / 3628800,    1.0 / 362880,    1.0 / 40320,
+            1.0 / 5040,       1.0 / 720,       1.0 / 120,
+            1.0 / 24,         1.0 / 6,         1.0 / 2};
+        p = polynomial(r, coefs);
+    } else {
+        static constexpr float coefs[] = {
+            1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f,
+            4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f};
+        p = polynomial(r, coefs);
+    }
+    return scale<Tp_>(r * r * p + r + Tp_(1), n);
+}
+
+// Splits positive finite x into 2^e m with m in [sqrt(1/2), sqrt(2)),
+// scaling subnormals up first.
+template<class Tp_>
+inline auto log_reduce(native<Tp_> x) noexcept {
+    constexpr auto extra  = mantissa_bits<Tp_> + 2;
+    constexpr auto one    = std::bit_cast<lane<Tp_>>(Tp_(1));
+    constexpr auto middle = std::bit_cast<lane<Tp_>>(
+        std::numbers::sqrt2_v<Tp_> / 2);
+    constexpr auto mantissa = (lane<Tp_>(1) << mantissa_bits<Tp_>) - 1;
+
+    auto tiny = x < std::numeric_limits<Tp_>::min();
+    x         = tiny ? x * Tp_(lane<Tp_>(1) << extra) : x;
+    auto bits = std::bit_cast<integer<Tp_>>(x) + (one - middle);
+    auto e    = (bits >> mantissa_bits<Tp_>) - exponent_bias<Tp_>
+           - (tiny & extra);
+    auto m = std::bit_cast<native<Tp_>>((bits & mantissa) + middle);
+    return std::pair(m, __builtin_convertvector(e, native<Tp_>));
+}
+
+// Coefficients of R(z) / z with ln((1 + s) / (1 - s)) = 2s + s R(s^2),
+// from fdlibm.
+template<class Tp_>
+constexpr auto log_coefs() noexcept {
+    if constexpr (std::same_as<Tp_, double>)
+        return std::array {1.479819860511658591e-01, 1.531383769920937332e-01,
+                           1.818357216161805012e-01, 2.222219843214978396e-01,
+                           2.857142874366239149e-01, 3.999999999940941908e-01,
+                           6.666666666666735130e-01};
+    else
+        return std::array {2.4279078841e-01f, 2.8498786688e-01f,
+                           4.0000972152e-01f, 6.6666662693e-01f};
+}
+
+template<class Tp_>
+inline auto log_series(const native<Tp_>& z) noexcept {
+    static constexpr auto coefs = log_coefs<Tp_>();
+    return z * polynomial(z, coefs);
+}
+
+// ln(x) = e ln(2) + ln(1 + f) with 1 + f = m, where ln(1 + f) is computed
+// from s = f / (2 + f) as in fdlibm.
+template<class Tp_>
+inline auto log_kernel(const native<Tp_>& x) noexcept {
+    auto [m, e] = log_reduce<Tp_>(x);
+    auto f      = m - Tp_(1);
+    auto s      = f / (f + Tp_(2));
+    auto r      = log_series<Tp_>(s * s);
+    auto hfsq   = Tp_(0.5) * f * f;
+    auto result = e * ln2_hi<Tp_>
+                - ((hfsq - (s * (hfsq + r) + e * ln2_lo<Tp_>)) - f);
+
+    constexpr auto inf = std::numeric_limits<Tp_>::infinity();
+    result             = x == inf ? x : result;
+    result             = x == 0 ? splat(-inf) : result;
+    return x >= 0 ? result : splat(std::numeric_limits<Tp_>::quiet_NaN());
+}
+
+// Coefficients 2 / (2k + 1) of the series of ln((1 + s) / (1 - s)) in s^2k
+// from the highest degree down to k = 2, enough of them for a truncation
+// error 12 bits below the precision of Tp_.
+template<class Tp_>
+constexpr auto atanh_coefs() noexcept {
+    constexpr std::size_t  count = std::same_as<Tp_, double> ? 11 : 5;
+    std::array<Tp_, count> coefs {};
+    for (std::size_t i = 0; i < count; ++i)
+        coefs[i] = Tp_(2.0L / static_cast<long double>(2 * (count - i) + 3));
+    return coefs;
+}
+
+// ln(x) of positive finite x as an unevaluated sum hi + lo carrying about
+// 12 bits more than Tp_, for pow. With the series of ln(1 + f) in s, the
+// division s = f / (2 + f) is corrected by its exact residual and 2s plus
+// 2/3 s^3 are summed with e ln(2) exactly, leaving only the rounding of the
+// much smaller terms. The correction of s enters 2s + 2/3 s^3 to first
+// order.
+template<class Tp_>
+inline auto log_extended(const native<Tp_>& x) noexcept {
+    static constexpr auto coefs   = atanh_coefs<Tp_>();
+    constexpr auto        lead_hi = Tp_(2.0L / 3);
+    constexpr auto        lead_lo = Tp_(2.0L / 3 - lead_hi);
+
+    auto [m, e]   = log_reduce<Tp_>(x);
+    auto f        = m - Tp_(1);
+    auto [bh, bl] = two_sum<Tp_>(splat(Tp_(2)), f);
+    auto sh       = f / bh;
+    auto [ph, pl] = two_product<Tp_>(sh, bh);
+    auto sl       = ((f - ph) - pl - sh * bl) / bh;
+
+    auto [zh, zl] = two_product<Tp_>(sh, sh);
+    auto [ch, cl] = two_product<Tp_>(zh, sh);
+    auto [dh, dl] = two_product<Tp_>(ch, splat(lead_hi));
+    auto cubic    = dl + (cl + zl * sh) * lead_hi + ch * lead_lo;
+    auto rest     = sh * zh * zh * polynomial(zh, coefs);
+
+    auto [h1, e1] = two_sum<Tp_>(e * ln2_hi<Tp_>, sh + sh);
+    auto [h2, e2] = two_sum<Tp_>(h1, dh);
+    auto lo = e1 + e2 + (sl + sl) * (zh + Tp_(1)) + cubic + rest
+            + e * ln2_lo<Tp_>;
+    auto sum = h2 + lo;
+    return std::pair(sum, lo - (sum - h2));
+}
+
+// pi/2 split in three, each part the rounding of what the previous ones
+// leave out.
+template<class Tp_>
+constexpr auto pio2_parts() noexcept {
+    if constexpr (std::same_as<Tp_, double>)
+        return std::array {1.5707963267948966, 6.123233995736766e-17,
+                           -1.4973849048591698e-33};
+    else
+        return std::array {1.5707963705062866f, -4.371138828673793e-08f,
+                           -1.7151245100058819e-15f};
+}
+
+// Arguments with |x| beyond this are left to libm, which reduces them with
+// as many bits of pi as it takes.
+template<class Tp_>
+constexpr auto reduction_limit = std::same_as<Tp_, double> ? Tp_(0x1p30)
+                                                           : Tp_(0x1p18);
+
+template<class Tp_>
+struct sincos_parts {
+    native<Tp_>  sin;
+    native<Tp_>  cos;
+    integer<Tp_> quadrant;
+};
+
+// sin(r) and cos(r) for r = x - n pi/2 in [-pi/4, pi/4], along with n.
+// With a fused multiply-add the first step of the reduction is exact, the
+// others lose less than an ulp of r.
+template<class Tp_>
+inline auto sincos_kernel(const native<Tp_>& x) noexcept {
+    constexpr auto pio2 = pio2_parts<Tp_>();
+    auto [nf, n]        = round_parts<Tp_>(x * std::numbers::inv_pi_v<Tp_> * 2);
+    auto r              = fma<Tp_>(-nf, splat(pio2[0]), x);
+    r                   = fma<Tp_>(-nf, splat(pio2[1]), r);
+    r                   = fma<Tp_>(-nf, splat(pio2[2]), r);
+    auto z = r * r;
+    auto s = native<Tp_> {};
+    auto c = native<Tp_> {};
+    if constexpr (std::same_as<Tp_, double>) {
+        static constexpr double sin_coefs[] = {
+            1.58969099521155010221e-10, -2.50507602534068634195e-08,
+            2.75573137070700676789e-06, -1.98412698298579493134e-04,
+            8.33333333332248946124e-03, -1.66666666666666324348e-01};
+        static constexpr double cos_coefs[] = {
+            -1.13596475577881948265e-11, 2.08757232129817482790e-09,
+            -2.75573143513906633035e-07, 2.48015872894767294178e-05,
+            -1.38888888888741095749e-03, 4.16666666666666019037e-02};
+        s = r + r * z * polynomial(z, sin_coefs);
+        c = z * z * polynomial(z, cos_coefs);
+    } else {
+        static constexpr float sin_coefs[] = {
+            -1.9515295891e-4f, 8.3321608736e-3f, -1.6666654611e-1f};
+        static constexpr float cos_coefs[] = {
+            2.443315711809948e-5f, -1.388731625493765e-3f,
+            4.166664568298827e-2f};
+        s = r + r * z * polynomial(z, sin_coefs);
+        c = z * z * polynomial(z, cos_coefs);
+    }
+    s = x == 0 ? x : s; // Keeps the sign of zero
+
+    // 1 - z/2 rounded once, with its rounding error folded into the tail
+    auto hz = Tp_(0.5) * z;
+    auto w  = Tp_(1) - hz;
+    c       = w + (((Tp_(1) - w) - hz) + c);
+    return sincos_parts<Tp_> {s, c, n};
+}
+
+// Replaces the lanes of result selected by mask with func of the lanes of
+// x, for the rare arguments that the kernels do not cover.
+template<class Tp_, class Fn_>
+inline auto fix_lanes(native<Tp_>         result,
+                      const native<Tp_>&  x,
+                      const integer<Tp_>& mask,
+                      Fn_                 func) {
+    if (any(mask))
+        for (std::size_t i = 0; i < batch<Tp_>::size; ++i)
+            if (mask[i])
+                result[i] = func(x[i]);
+    return result;
+}
+
+// Lanes beyond the reduction limit, including infinities but not NaN.
+template<class Tp_>
+inline auto beyond_reduction(const native<Tp_>& x) noexcept {
+    return abs<Tp_>(x) > reduction_limit<Tp_>;
+}
+
+// Calls a batch function on a single value.
+template<class Tp_, class Fn_>
+inline auto on_lane(Tp_ x, Fn_ func) {
+    return func(batch<Tp_>::broadcast(x))[0];
+}
+
+} // namespace detail
+
+template<class Tp_>
+concept vectorizable_float = vectorizable<Tp_> && std::floating_point<Tp_>;
+
+// Max error 1 ulp for float and double.
+template<vectorizable_float Tp_>
+inline auto exp(const batch<Tp_>& x) noexcept {
+    return batch<Tp_>(detail::exp_kernel<Tp_>(x.native()));
+}
+
+// Max error 1 ulp for float and double.
+template<vectorizable_float Tp_>
+inline auto log(const batch<Tp_>& x) noexcept {
+    return batch<Tp_>(detail::log_kernel<Tp_>(x.native()));
+}
+
+// Max error 1.5 ulp for float and double. Arguments beyond 2^30 for double
+// and 2^18 for float are left to libm.
+template<vectorizable_float Tp_>
+inline auto sin(const batch<Tp_>& x) noexcept {
+    auto [s, c, n] = detail::sincos_kernel<Tp_>(x.native());
+    auto result    = (n & 1) != 0 ? c : s;
+    result         = (n & 2) != 0 ? -result : result;
+    return batch<Tp_>(detail::fix_lanes<Tp_>(
+        result, x.native(), detail::beyond_reduction<Tp_>(x.native()),
+        [](Tp_ arg) { return std::sin(arg); }));
+}
+
+// Max error 1.5 ulp for float and double, with the same reduction as sin.
+template<vectorizable_float Tp_>
+inline auto cos(const batch<Tp_>& x) noexcept {
+    auto [s, c, n] = detail::sincos_kernel<Tp_>(x.native());
+    auto result    = (n & 1) != 0 ? s : c;
+    result         = ((n + 1) & 2) != 0 ? -result : result;
+    return batch<Tp_>(detail::fix_lanes<Tp_>(
+        result, x.native(), detail::beyond_reduction<Tp_>(x.native()),
+        [](Tp_ arg) { return std::cos(arg); }));
+}
+
+// sin and cos of the same argument from a single reduction.
+template<vectorizable_float Tp_>
+inline auto sincos(const batch<Tp_>& x) noexcept {
+    auto [s, c, n] = detail::sincos_kernel<Tp_>(x.native());
+    auto sine      = (n & 1) != 0 ? c : s;
+    auto cosine    = (n & 1) != 0 ? s : c;
+    sine           = (n & 2) != 0 ? -sine : sine;
+    cosine         = ((n + 1) & 2) != 0 ? -cosine : cosine;
+    auto beyond    = detail::beyond_reduction<Tp_>(x.native());
+    return std::pair(batch<Tp_>(detail::fix_lanes<Tp_>(
+                         sine, x.native(), beyond,
+                         [](Tp_ arg) { return std::sin(arg); })),
+                     batch<Tp_>(detail::fix_lanes<Tp_>(
+                         cosine, x.native(), beyond,
+                         [](Tp_ arg) { return std::cos(arg); })));
+}
+
+// Max error 3 ulp for float and double, with the same reduction as sin.
+template<vectorizable_float Tp_>
+inline auto tan(const batch<Tp_>& x) noexcept {
+    auto [s, c, n] = detail::sincos_kernel<Tp_>(x.native());
+    auto result    = (n & 1) != 0 ? -c / s : s / c;
+    return batch<Tp_>(detail::fix_lanes<Tp_>(
+        result, x.native(), detail::beyond_reduction<Tp_>(x.native()),
+        [](Tp_ arg) { return std::tan(arg); }));
+}
+
+// Max error 1.5 ulp for float and double. Small arguments use a rational
+// approximation from Cephes, larger ones 1 - 2 / (exp(2|x|) + 1).
+template<vectorizable_float Tp_>
+inline auto tanh(const batch<Tp_>& x) noexcept {
+    auto arg   = x.native();
+    auto ax    = detail::abs<Tp_>(arg);
+    auto z     = arg * arg;
+    auto small = detail::native<Tp_> {};
+    if constexpr (std::same_as<Tp_, double>) {
+        static constexpr double num[] = {-9.64399179425052238628e-1,
+                                         -9.92877231001918586564e1,
+                                         -1.61468768441708447952e3};
+        static constexpr double den[] = {1.0, 1.12811678491632931402e2,
+                                         2.23548839060100448583e3,
+                                         4.84406305325125486048e3};
+        small = arg + arg * z * (detail::polynomial(z, num)
+                                 / detail::polynomial(z, den));
+    } else {
+        static constexpr float coefs[] = {-5.70498872745e-3f, 2.06390887954e-2f,
+                                          -5.37397155531e-2f, 1.33314422036e-1f,
+                                          -3.33332819422e-1f};
+        small = arg + arg * z * detail::polynomial(z, coefs);
+    }
+    auto e     = detail::exp_kernel<Tp_>(ax + ax);
+    auto large = detail::copysign<Tp_>(Tp_(1) - Tp_(2) / (e + Tp_(1)), arg);
+    small      = arg == 0 ? arg : small;
+    return batch<Tp_>(ax < Tp_(0.625) ? small : large);
+}
+
+// Logistic function 1 / (1 + exp(-x)), max error 3 ulp for float and
+// double. Negative arguments use exp(x) / (1 + exp(x)) so that the result
+// does not underflow early.
+template<vectorizable_float Tp_>
+inline auto sigmoid(const batch<Tp_>& x) noexcept {
+    auto arg    = x.native();
+    auto e      = detail::exp_kernel<Tp_>(-detail::abs<Tp_>(arg));
+    auto result = Tp_(1) / (e + Tp_(1));
+    return batch<Tp_>(arg < 0 ? e * result : result);
+}
+
+// Correctly rounded, as it is an instruction.
+template<vectorizable_float Tp_>
+inline auto sqrt(const batch<Tp_>& x) noexcept {
+    auto arg = x.native();
+#if defined(__AVX512F__)
+    if constexpr (std::same_as<Tp_, double>)
+        return batch<Tp_>(std::bit_cast<detail::native<Tp_>>(
+            _mm512_sqrt_pd(std::bit_cast<__m512d>(arg))));
+    else
+        return batch<Tp_>(std::bit_cast<detail::native<Tp_>>(
+            _mm512_sqrt_ps(std::bit_cast<__m512>(arg))));
+#elif defined(__AVX__)
+    if constexpr (std::same_as<Tp_, double>)
+        return batch<Tp_>(std::bit_cast<detail::native<Tp_>>(
+            _mm256_sqrt_pd(std::bit_cast<__m256d>(arg))));
+    else
+        return batch<Tp_>(std::bit_cast<detail::native<Tp_>>(
+            _mm256_sqrt_ps(std::bit_cast<__m256>(arg))));
+#elif defined(__SSE2__)
+    if constexpr (std::same_as<Tp_, double>)
+        return batch<Tp_>(std::bit_cast<detail::native<Tp_>>(
+            _mm_sqrt_pd(std::bit_cast<__m128d>(arg))));
+    else
+        return batch<Tp_>(std::bit_cast<detail::native<Tp_>>(
+            _mm_sqrt_ps(std::bit_cast<__m128>(arg))));
+#else
+    for (std::size_t i = 0; i < batch<Tp_>::size; ++i)
+        arg[i] = std::sqrt(arg[i]);
+    return batch<Tp_>(arg);
+#endif
+}
+
+// x^y for a scalar exponent, computed as exp(y ln(x)) with ln(x) carried
+// in extended precision so that large exponents do not magnify its error.
+// Max error 1.5 ulp for float and double. Exponents 0, 1, 2 and -1 are
+// exact or correctly rounded, and special values follow std::pow.
+template<vectorizable_float Tp_>
+inline auto pow(const batch<Tp_>& x, Tp_ y) noexcept {
+    using native = detail::native<Tp_>;
+    if (y == 0)
+        return batch<Tp_>::broadcast(1);
+    else if (y == 1)
+        return x;
+    else if (y == 2)
+        return x * x;
+    else if (y == -1)
+        return batch<Tp_>::broadcast(1) / x;
+
+    auto arg = x.native();
+    if (!std::isfinite(y)) {
+        for (std::size_t i = 0; i < batch<Tp_>::size; ++i)
+            arg[i] = std::pow(arg[i], y);
+        return batch<Tp_>(arg);
+    }
+
+    constexpr auto inf = std::numeric_limits<Tp_>::infinity();
+    constexpr auto nan = std::numeric_limits<Tp_>::quiet_NaN();
+    auto           ax  = detail::abs<Tp_>(arg);
+    auto [lh, ll]      = detail::log_extended<Tp_>(ax);
+    auto [ph, pl]      = detail::two_product<Tp_>(detail::splat(y), lh);
+    pl += y * ll;
+    pl          = detail::abs<Tp_>(ph) < Tp_(1024) ? pl : native {};
+    auto result = detail::exp_kernel<Tp_>(ph, pl);
+    result      = ax == 0 ? detail::splat(y > 0 ? Tp_(0) : inf) : result;
+    result      = ax == inf ? detail::splat(y > 0 ? inf : Tp_(0)) : result;
+    result      = ax != ax ? ax : result;
+
+    // Negative bases only have real powers for integer exponents
+    auto integral = std::trunc(y) == y;
+    if (integral && std::fmod(y, Tp_(2)) != 0)
+        result = detail::copysign<Tp_>(result, arg);
+    else if (!integral)
+        result = arg < 0 && ax != inf ? detail::splat(nan) : result;
+    return batch<Tp_>(result);
+}
+
+template<class Tp_>
+    requires std::is_arithmetic_v<Tp_>
+inline auto exp(Tp_ x) {
+    if constexpr (vectorizable_float<Tp_>)
+        return detail::on_lane(x, [](auto arg) { return exp(arg); });
+    else
+        return std::exp(x);
+}
+
+template<class Tp_>
+    requires std::is_arithmetic_v<Tp_>
+inline auto log(Tp_ x) {
+    if constexpr (vectorizable_float<Tp_>)
+        return detail::on_lane(x, [](auto arg) { return log(arg); });
+    else
+        return std::log(x);
+}
+
+template<class Tp_>
+    requires std::is_arithmetic_v<Tp_>
+inline auto sin(Tp_ x) {
+    if constexpr (vectorizable_float<Tp_>)
+        return detail::on_lane(x, [](auto arg) { return sin(arg); });
+    else
+        return std::sin(x);
+}
+
+template<class Tp_>
+    requires std::is_arithmetic_v<Tp_>
+inline auto cos(Tp_ x) {
+    if constexpr (vectorizable_float<Tp_>)
+        return detail::on_lane(x, [](auto arg) { return cos(arg); });
+    else
+        return std::cos(x);
+}
+
+template<class Tp_>
+    requires std::is_arithmetic_v<Tp_>
+inline auto tan(Tp_ x) {
+    if constexpr (vectorizable_float<Tp_>)
+        return detail::on_lane(x, [](auto arg) { return tan(arg); });
+    else
+        return std::tan(x);
+}
+
+template<class Tp_>
+    requires std::is_arithmetic_v<Tp_>
+inline auto tanh(Tp_ x) {
+    if constexpr (vectorizable_float<Tp_>)
+        return detail::on_lane(x, [](auto arg) { return tanh(arg); });
+    else
+        return std::tanh(x);
+}
+
+template<class Tp_>
+    requires std::is_arithmetic_v<Tp_>
+inline auto sigmoid(Tp_ x) {
+    if constexpr (vectorizable_float<Tp_>)
+        return detail::on_lane(x, [](auto arg) { return sigmoid(arg); });
+    else if constexpr (std::is_integral_v<Tp_>)
+        return sigmoid(static_cast<double>(x));
+    else
+        return x < 0 ? std::exp(x) / (1 + std::exp(x)) : 1 / (1 + std::exp(-x));
+}
+
+// The square root is the same on a lane as in a register.
+template<class Tp_>
+    requires std::is_arithmetic_v<Tp_>
+inline auto sqrt(Tp_ x) {
+    return std::sqrt(x);
+}
+
+template<class Tp_, class Ex_>
+    requires std::is_arithmetic_v<Tp_> && std::is_arithmetic_v<Ex_>
+inline auto pow(Tp_ x, Ex_ y) {
+    if constexpr (vectorizable_float<Tp_> && std::same_as<Tp_, Ex_>)
+        return detail::on_lane(x, [y](auto arg) { return pow(arg, y); });
+    else
+        return std::pow(x, y);
+}
+
+} // namespace ax::simd
+
+#endif /* SIMD_MATH_H_DEFINED */
@@ -0,0 +1,135 @@
+#ifndef SIMD_SELECT_H_DEFINED
+#define SIMD_SELECT_H_DEFINED
+
+#include "batch.hpp"
+
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <utility>
+
+// Compress and expand of the lanes of a batch under a mask of bools, one
+// per lane. AVX-512 packs and spreads the lanes with a single instruction
+// and moves exactly the selected elements with a masked load or store.
+// Other targets go a lane at a time, callers check native_compress and keep
+// to their own scalar loops there.
+
+namespace ax::simd {
+
+#if defined(__AVX512F__)
+constexpr bool native_compress = true;
+#else
+constexpr bool native_compress = false;
+#endif
+
+namespace detail {
+
+#if defined(__AVX512F__)
+// Mask register of the lanes of a batch of Tp_ whose bools are set.
+template<vectorizable Tp_>
+inline auto lane_mask(const bool* mask) noexcept {
+    auto bytes = reinterpret_cast<const __m128i*>(mask);
+    if constexpr (batch<Tp_>::size == 16) {
+        auto lanes = _mm512_cvtepu8_epi32(_mm_loadu_si128(bytes));
+        return _mm512_test_epi32_mask(lanes, lanes);
+    } else {
+        auto lanes = _mm512_cvtepu8_epi64(_mm_loadl_epi64(bytes));
+        return _mm512_test_epi64_mask(lanes, lanes);
+    }
+}
+
+// Mask register of the first count lanes.
+template<vectorizable Tp_>
+inline auto head_mask(std::size_t count) noexcept {
+    using mask_type = decltype(lane_mask<Tp_>(nullptr));
+    return static_cast<mask_type>((1u << count) - 1);
+}
+#endif
+
+} // namespace detail
+
+// Writes the lanes of value whose mask is set to consecutive elements at
+// dst, in order, and returns how many were written. Nothing past them is
+// touched.
+template<vectorizable Tp_>
+inline std::size_t compress_store(Tp_*              dst,
+                                  const batch<Tp_>& value,
+                                  const bool*       mask) noexcept {
+#if defined(__AVX512F__)
+    auto lanes = detail::lane_mask<Tp_>(mask);
+    auto count = static_cast<std::size_t>(std::popcount(lanes));
+    auto head  = detail::head_mask<Tp_>(count);
+    if constexpr (std::same_as<Tp_, float>) {
+        auto v = std::bit_cast<__m512>(value.native());
+        _mm512_mask_storeu_ps(dst, head, _mm512_maskz_compress_ps(lanes, v));
+    } else if constexpr (std::same_as<Tp_, double>) {
+        auto v = std::bit_cast<__m512d>(value.native());
+        _mm512_mask_storeu_pd(dst, head, _mm512_maskz_compress_pd(lanes, v));
+    } else if constexpr (std::same_as<Tp_, std::int32_t>) {
+        auto v = std::bit_cast<__m512i>(value.native());
+        _mm512_mask_storeu_epi32(dst, head,
+                                 _mm512_maskz_compress_epi32(lanes, v));
+    } else {
+        auto v = std::bit_cast<__m512i>(value.native());
+        _mm512_mask_storeu_epi64(dst, head,
+                                 _mm512_maskz_compress_epi64(lanes, v));
+    }
+    return count;
+#else
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < batch<Tp_>::size; ++i)
+        if (mask[i])
+            dst[count++] = value[i];
+    return count;
+#endif
+}
+
+// Replaces the lanes of value whose mask is set with consecutive elements
+// read from src, in order. Returns the new batch and how many elements were
+// read, nothing past them is touched.
+template<vectorizable Tp_>
+inline auto expand_load(const Tp_*        src,
+                        const batch<Tp_>& value,
+                        const bool*       mask) noexcept {
+#if defined(__AVX512F__)
+    using native_type = typename batch<Tp_>::native_type;
+    auto lanes  = detail::lane_mask<Tp_>(mask);
+    auto count  = static_cast<std::size_t>(std::popcount(lanes));
+    auto head   = detail::head_mask<Tp_>(count);
+    auto result = [&] {
+        if constexpr (std::same_as<Tp_, float>) {
+            auto v = std::bit_cast<__m512>(value.native());
+            auto x = _mm512_maskz_loadu_ps(head, src);
+            return std::bit_cast<native_type>(
+                _mm512_mask_expand_ps(v, lanes, x));
+        } else if constexpr (std::same_as<Tp_, double>) {
+            auto v = std::bit_cast<__m512d>(value.native());
+            auto x = _mm512_maskz_loadu_pd(head, src);
+            return std::bit_cast<native_type>(
+                _mm512_mask_expand_pd(v, lanes, x));
+        } else if constexpr (std::same_as<Tp_, std::int32_t>) {
+            auto v = std::bit_cast<__m512i>(value.native());
+            auto x = _mm512_maskz_loadu_epi32(head, src);
+            return std::bit_cast<native_type>(
+                _mm512_mask_expand_epi32(v, lanes, x));
+        } else {
+            auto v = std::bit_cast<__m512i>(value.native());
+            auto x = _mm512_maskz_loadu_epi64(head, src);
+            return std::bit_cast<native_type>(
+                _mm512_mask_expand_epi64(v, lanes, x));
+        }
+    }();
+    return std::pair(batch<Tp_>(result), count);
+#else
+    auto        result = value.native();
+    std::size_t count  = 0;
+    for (std::size_t i = 0; i < batch<Tp_>::size; ++i)
+        if (mask[i])
+            result[i] = src[count++];
+    return std::pair(batch<Tp_>(result), count);
+#endif
+}
+
+} // namespace ax::simd
+
+#endif /* SIMD_SELECT_H_DEFINED */
@@ -0,0 +1,151 @@
+#ifndef SIMD_TRANSPOSE_H_DEFINED
+#define SIMD_TRANSPOSE_H_DEFINED
+
+#include "batch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+// Transposes of square tiles held in registers. A tile of n x n elements is
+// loaded as n rows of one register each and transposed by log2(n) rounds of
+// interleaving, which the compiler lowers to the unpack and permute
+// instructions of the target. Elements are moved as unsigned integers of
+// their width, so any trivially copyable type of 1, 2, 4 or 8 bytes works.
+
+namespace ax::simd {
+
+template<class Tp_>
+concept tile_transposable
+    = std::is_trivially_copyable_v<Tp_>
+   && (sizeof(Tp_) == 1 || sizeof(Tp_) == 2 || sizeof(Tp_) == 4
+       || sizeof(Tp_) == 8);
+
+// Edge of the tiles transposed in registers, one register per row and at
+// most 16 rows so that a tile and its temporaries stay in registers.
+template<class Tp_>
+constexpr std::size_t tile_size
+    = std::clamp<std::size_t>(register_bytes / sizeof(Tp_), 2, 16);
+
+namespace detail {
+
+template<std::size_t Sz_>
+struct tile_lane_impl;
+
+template<>
+struct tile_lane_impl<1> {
+    using type = std::uint8_t;
+};
+
+template<>
+struct tile_lane_impl<2> {
+    using type = std::uint16_t;
+};
+
+template<>
+struct tile_lane_impl<4> {
+    using type = std::uint32_t;
+};
+
+template<>
+struct tile_lane_impl<8> {
+    using type = std::uint64_t;
+};
+
+template<class Tp_>
+using tile_lane = typename tile_lane_impl<sizeof(Tp_)>::type;
+
+template<class Tp_>
+struct tile_row_impl {
+    using type [[gnu::vector_size(tile_size<Tp_> * sizeof(Tp_))]]
+    = tile_lane<Tp_>;
+};
+
+template<class Tp_>
+using tile_row = typename tile_row_impl<Tp_>::type;
+
+template<class Tp_>
+using tile_rows = std::array<tile_row<Tp_>, tile_size<Tp_>>;
+
+template<class Tp_>
+inline auto load_tile(const Tp_* src, std::ptrdiff_t ld) noexcept {
+    auto rows = tile_rows<Tp_> {};
+    for (std::size_t i = 0; i < rows.size(); ++i)
+        std::memcpy(&rows[i], src + static_cast<std::ptrdiff_t>(i) * ld,
+                    sizeof(rows[i]));
+    return rows;
+}
+
+template<class Tp_>
+inline void
+store_tile(const tile_rows<Tp_>& rows, Tp_* dst, std::ptrdiff_t ld) noexcept {
+    for (std::size_t i = 0; i < rows.size(); ++i)
+        std::memcpy(dst + static_cast<std::ptrdiff_t>(i) * ld, &rows[i],
+                    sizeof(rows[i]));
+}
+
+// Interleaves the low halves and the high halves of two rows.
+template<class Rw_, std::size_t... Is_>
+inline auto
+interleave(const Rw_& lhs, const Rw_& rhs, std::index_sequence<Is_...>) {
+    constexpr auto n = sizeof...(Is_);
+    return std::pair(
+        __builtin_shufflevector(lhs, rhs,
+                                (Is_ % 2 ? n + Is_ / 2 : Is_ / 2)...),
+        __builtin_shufflevector(lhs, rhs,
+                                (Is_ % 2 ? n + n / 2 + Is_ / 2
+                                         : n / 2 + Is_ / 2)...));
+}
+
+// Each round interleaves row i with row i + n / 2 into rows 2i and 2i + 1,
+// after log2(n) rounds row i holds column i.
+template<class Tp_>
+inline void transpose_rows(tile_rows<Tp_>& rows) noexcept {
+    constexpr auto n    = tile_size<Tp_>;
+    constexpr auto lane = std::make_index_sequence<n>();
+    for (auto round = n; round > 1; round /= 2) {
+        auto next = tile_rows<Tp_> {};
+        for (std::size_t i = 0; i < n / 2; ++i)
+            std::tie(next[2 * i], next[2 * i + 1])
+                = interleave(rows[i], rows[i + n / 2], lane);
+        rows = next;
+    }
+}
+
+} // namespace detail
+
+// Stores the transpose of the tile at src, whose rows are sld elements
+// apart, at dst with rows dld elements apart. The tile is read in full
+// before it is written, so src and dst may be the same tile.
+template<tile_transposable Tp_>
+inline void transpose_tile(const Tp_*     src,
+                           std::ptrdiff_t sld,
+                           Tp_*           dst,
+                           std::ptrdiff_t dld) noexcept {
+    auto rows = detail::load_tile(src, sld);
+    detail::transpose_rows<Tp_>(rows);
+    detail::store_tile(rows, dst, dld);
+}
+
+// Swaps two tiles of a matrix with rows ld elements apart, transposing each
+// on the way. Used on the tiles at (i, j) and (j, i) it transposes that part
+// of a square matrix in place.
+template<tile_transposable Tp_>
+inline void
+swap_transpose_tiles(Tp_* lhs, Tp_* rhs, std::ptrdiff_t ld) noexcept {
+    auto lrows = detail::load_tile(lhs, ld);
+    auto rrows = detail::load_tile(rhs, ld);
+    detail::transpose_rows<Tp_>(lrows);
+    detail::transpose_rows<Tp_>(rrows);
+    detail::store_tile(lrows, rhs, ld);
+    detail::store_tile(rrows, lhs, ld);
+}
+
+} // namespace ax::simd
+
+#endif /* SIMD_TRANSPOSE_H_DEFINED */
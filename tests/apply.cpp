@@ -0,0 +1,57 @@
+#include "common.hpp"
+
+#include <cstddef>
+
+using namespace ax;
+
+namespace {
+
+auto make_ramp(const shape_type& shape) {
+    auto array = ndarray<double>(shape);
+    for (std::size_t i = 0; i < array.size(); ++i)
+        array.data()[i] = static_cast<double>(i) - 500.0;
+    return array;
+}
+
+// Generic lambdas whose bodies only compile for scalars run element by
+// element, whether or not the operands would fit the SIMD batches.
+void apply_generic_lambdas() {
+    const auto a = make_ramp(shape_type {10, 100});
+
+    auto square = a.apply([](auto x) { return x * x + 1; });
+    auto relu   = a.apply([](auto x) { return x > 0 ? x : 0.0; });
+    auto sum    = a.apply([](auto x, auto y) { return x * y + 1; }, a);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        auto x = a.data()[i];
+        ax_check(square.data()[i] == x * x + 1);
+        ax_check(relu.data()[i] == (x > 0 ? x : 0.0));
+        ax_check(sum.data()[i] == x * x + 1);
+    }
+
+    auto strided = a.slice(ellipsis, range(none, none, 2));
+    auto halves  = strided.apply([](auto x) { return x > 0 ? x : 0.0; });
+    for (std::size_t i = 0; i < 10; ++i)
+        for (std::size_t j = 0; j < 50; ++j) {
+            auto x = a.data()[i * 100 + 2 * j];
+            ax_check((halves[i, j]) == (x > 0 ? x : 0.0));
+        }
+
+    auto moved = make_ramp(shape_type {1000});
+    moved      = std::move(moved).apply([](auto x) { return x * x + 1; });
+    ax_check(moved.data()[0] == 500.0 * 500.0 + 1);
+}
+
+// The same lambda opted into the batches gives the same results.
+void apply_vectorized_lambda() {
+    const auto a      = make_ramp(shape_type {10, 100});
+    auto       square = a.apply(simd::vectorize([](auto x) { return x * x; }));
+    for (std::size_t i = 0; i < a.size(); ++i)
+        ax_check(square.data()[i] == a.data()[i] * a.data()[i]);
+}
+
+} // namespace
+
+int main() {
+    apply_generic_lambdas();
+    apply_vectorized_lambda();
+}
@@ -0,0 +1,102 @@
+#include "common.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+using namespace ax;
+
+namespace {
+
+auto temp_path(const char* name) {
+    return std::filesystem::temp_directory_path() / name;
+}
+
+// A chunk of a single element is broadcast against a row of higher rank
+// than its own, which has to keep the leading axis of the chunk.
+void broadcast_one_row_chunks() {
+    auto column = ndarray<double>(shape_type {5, 1});
+    auto row    = ndarray<double>(shape_type {4});
+    for (std::size_t i = 0; i < 5; ++i)
+        column.data()[i] = static_cast<double>(i);
+    for (std::size_t j = 0; j < 4; ++j)
+        row.data()[j] = static_cast<double>(10 * j);
+    save_npy(temp_path("axiom_column.npy"), column);
+
+    auto chunked = chunked_array<double>(temp_path("axiom_column.npy"), 24);
+    ax_check(chunked.chunk_rows() == 1);
+    auto result = load_npy<double>(
+        broadcast(chunked, row, temp_path("axiom_sum.npy"), std::plus {})
+            .path());
+    ax_check(result.shape() == (shape_type {5, 4}));
+    for (std::size_t i = 0; i < 5; ++i)
+        for (std::size_t j = 0; j < 4; ++j)
+            ax_check(result.data()[i * 4 + j]
+                     == static_cast<double>(i + 10 * j));
+
+    std::filesystem::remove(temp_path("axiom_column.npy"));
+    std::filesystem::remove(temp_path("axiom_sum.npy"));
+}
+
+void broadcast_scalar_shape() {
+    auto scalar = ndarray<double>(shape_type {1, 1});
+    auto row    = ndarray<double>(shape_type {4});
+    ax_check(broadcast(scalar, row, std::plus {}).shape()
+             == (shape_type {1, 4}));
+    ax_check(broadcast(row, scalar, std::plus {}).shape()
+             == (shape_type {1, 4}));
+    ax_check(broadcast(row, ndarray<double>(shape_type {1}), std::plus {})
+                 .shape()
+             == (shape_type {4}));
+}
+
+// An array of higher rank has no rows to match the chunks with, even with
+// a leading axis of length one.
+void broadcast_higher_rank() {
+    save_npy(temp_path("axiom_rows.npy"), ndarray<double>(shape_type {5, 4}));
+    auto chunked = chunked_array<double>(temp_path("axiom_rows.npy"));
+#if defined(AX_TEST_ABORTS)
+    ax_check(test::aborts([&] {
+        broadcast(chunked, ndarray<double>(shape_type {1, 5, 4}),
+                  temp_path("axiom_sum.npy"), std::plus {});
+    }));
+#endif
+    auto result = broadcast(chunked, ndarray<double>(shape_type {1, 4}),
+                            temp_path("axiom_sum.npy"), std::plus {});
+    ax_check(result.shape() == (shape_type {5, 4}));
+
+    std::filesystem::remove(temp_path("axiom_rows.npy"));
+    std::filesystem::remove(temp_path("axiom_sum.npy"));
+}
+
+// Files that cannot be opened or read throw, with or without assertions.
+void file_errors() {
+    ax_check(test::throws([] {
+        auto array = chunked_array<double>(temp_path("axiom_missing.npy"));
+    }));
+
+    auto path = temp_path("axiom_truncated.npy");
+    save_npy(path, ndarray<double>(shape_type {8, 4}));
+    auto chunked = chunked_array<double>(path, 3 * 4 * sizeof(double));
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+    chunked.chunk(0);
+    ax_check(test::throws([&] { chunked.chunk(chunked.chunk_count() - 1); }));
+    ax_check(test::throws([&] { sum(chunked); }));
+
+    {
+        auto out = std::ofstream(path, std::ios::binary);
+        out << "not an npy file";
+    }
+    ax_check(test::throws([&] { auto array = chunked_array<double>(path); }));
+    std::filesystem::remove(path);
+}
+
+} // namespace
+
+int main() {
+    broadcast_one_row_chunks();
+    broadcast_scalar_shape();
+    broadcast_higher_rank();
+    file_errors();
+}
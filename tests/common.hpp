@@ -0,0 +1,60 @@
+#ifndef TESTS_COMMON_H_DEFINED
+#define TESTS_COMMON_H_DEFINED
+
+#include "ndarray.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+#if __has_include(<sys/wait.h>)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Like ax_assert, but kept under NDEBUG and exiting with a failure status
+// for ctest instead of aborting.
+#define ax_check(condition)                                         \
+    if (!(condition)) {                                             \
+        std::cerr << __FILE__ << ':' << __LINE__ << ":\n"           \
+                  << "Check failed: " << #condition << '\n';        \
+        std::exit(EXIT_FAILURE);                                    \
+    }
+
+namespace ax::test {
+
+template<class Fn_>
+inline bool throws(Fn_&& func) {
+    try {
+        func();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+#if __has_include(<sys/wait.h>) && !defined(NDEBUG)
+
+// Runs func in a child process, whose messages are dropped, and tells
+// whether it failed there as on a failed ax_assert. Only defined when
+// assertions are compiled in.
+template<class Fn_>
+inline bool aborts(Fn_&& func) {
+    auto pid = ::fork();
+    if (pid == 0) {
+        ::close(STDERR_FILENO);
+        func();
+        std::_Exit(EXIT_SUCCESS);
+    }
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    return !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS;
+}
+
+#define AX_TEST_ABORTS
+
+#endif
+
+} // namespace ax::test
+
+#endif /* TESTS_COMMON_H_DEFINED */
@@ -0,0 +1,69 @@
+#include "common.hpp"
+
+#include <cstddef>
+#include <utility>
+
+using namespace ax;
+
+namespace {
+
+auto make_ramp() {
+    auto array = ndarray<double>(shape_type {3, 4});
+    for (std::size_t i = 0; i < array.size(); ++i)
+        array.data()[i] = static_cast<double>(i);
+    return array;
+}
+
+// Views of a const array copy its buffer before they are first written to,
+// so writing to them leaves the array as it was.
+void const_views_copy_on_write() {
+    auto        mutable_array = make_ramp();
+    const auto& array         = mutable_array;
+
+    auto row = array.view(0);
+    row[1]   = 100;
+    ax_check((array[0, 1]) == 1 && row[1] == 100);
+
+    auto column = array.slice(all, 1);
+    column[0]   = 100;
+    ax_check((array[0, 1]) == 1);
+
+    auto transposed  = array.transpose();
+    transposed[1, 0] = 100;
+    ax_check((array[0, 1]) == 1);
+
+    auto flat = array.reshape({12});
+    flat[1]   = 100;
+    ax_check((array[0, 1]) == 1);
+}
+
+// Views of a mutable array write through to it.
+void mutable_views_write_through() {
+    auto array = make_ramp();
+
+    array.view(0)[1] = 7;
+    ax_check((array[0, 1]) == 7);
+
+    array.slice(all, 2)[1] = 8;
+    ax_check((array[1, 2]) == 8);
+
+    array.transpose()[3, 2] = 9;
+    ax_check((array[2, 3]) == 9);
+
+    array.reshape({12})[11] = 10;
+    ax_check((array[2, 3]) == 10);
+
+    // Reading the array through const views, as printing does, keeps its
+    // views writing through
+    auto row = array.view(1);
+    std::as_const(array).view(1);
+    row[0] = 11;
+    ax_check((array[1, 0]) == 11);
+}
+
+} // namespace
+
+int main() {
+    const_views_copy_on_write();
+    mutable_views_write_through();
+}
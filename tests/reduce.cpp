@@ -0,0 +1,37 @@
+#include "common.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+using namespace ax;
+
+namespace {
+
+// A row of nothing but NaN reduces to NaN when NaN is omitted, as the
+// full-array extremes do, while the other rows skip their NaN.
+void extremes_of_nan_rows() {
+    auto nan   = std::numeric_limits<double>::quiet_NaN();
+    auto array = ndarray<double>(
+        {{nan, nan, nan}, {3., nan, -1.}, {2., 5., 4.}});
+
+    auto lo = min(array, {1}, false, nan_policy::omit);
+    auto hi = max(array, {1}, false, nan_policy::omit);
+    ax_check(std::isnan(lo[0]) && std::isnan(hi[0]));
+    ax_check(lo[1] == -1. && hi[1] == 3.);
+    ax_check(lo[2] == 2. && hi[2] == 5.);
+
+    auto first = argmin(array.slice(range(1, 3)), {1}, false, nan_policy::omit);
+    auto last  = argmax(array.slice(range(1, 3)), {1}, false, nan_policy::omit);
+    ax_check(first[0] == 2 && first[1] == 0);
+    ax_check(last[0] == 0 && last[1] == 1);
+
+    auto spread = min(array, {1}, false);
+    ax_check(std::isnan(spread[0]) && std::isnan(spread[1]) && spread[2] == 2.);
+}
+
+} // namespace
+
+int main() {
+    extremes_of_nan_rows();
+}